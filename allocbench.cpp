@@ -0,0 +1,166 @@
+// counting heap allocations made by string results,
+// with std::string and with string_view kept in an Arena
+#include "instream.h"
+#include "outstream.h"
+#include "arena.h"
+#include <vector>
+#include <string_view>
+#include <new>
+#include <stdlib.h>
+#include <time.h>
+using namespace std;
+using namespace stream;
+
+static uint64_t allocs;
+
+void *operator new(size_t n) {
+    ++allocs;
+    void *p = malloc(n ? n : 1);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+static uint64_t millisecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    return 1000L*ts.tv_sec + ts.tv_nsec/1000000L;
+}
+
+const int lines_per_batch = 100000;
+const int words_per_line = 4;
+const int batches = 10;
+const char *file = "allocs.dat";
+
+void make_file() {
+    Writer w(file);
+    for (int i = 0; i < lines_per_batch; i++) {
+        for (int j = 0; j < words_per_line; j++) {
+            w.fmt("token-%08d-abcdefgh ",i*words_per_line+j);
+        }
+        w();
+    }
+}
+
+struct Count {
+    const char *name;
+    uint64_t allocs, start;
+
+    Count(const char *name) : name(name), allocs(::allocs), start(millisecs()) {}
+    ~Count() {
+        uint64_t ms = millisecs() - start;
+        uint64_t n = ::allocs - allocs;
+        outs(name)(n)("allocations")((double)n/batches,"%.1f")("per batch")(ms)("ms")();
+    }
+};
+
+void lines_string() {
+    Count c("getlines string     ");
+    vector<string> lines;
+    for (int b = 0; b < batches; b++) {
+        lines.clear();
+        Reader(file).getlines(lines);
+    }
+}
+
+void lines_view(Arena& arena) {
+    Count c("getlines string_view");
+    vector<string_view> lines;
+    for (int b = 0; b < batches; b++) {
+        lines.clear();
+        arena.reset();
+        Reader(file).use(arena).getlines<string_view>(lines);
+    }
+}
+
+// each line gets its own StrReader, like a line got from a file
+void words_string(const vector<string>& text) {
+    Count c("words string        ");
+    vector<string> words;
+    string w;
+    for (int b = 0; b < batches; b++) {
+        words.clear();
+        for (const string& line : text) {
+            StrReader rdr(line);
+            for (int i = 0; i < words_per_line && rdr(w); i++) {
+                words.push_back(w);
+            }
+        }
+    }
+}
+
+void words_view(const vector<string>& text, Arena& arena) {
+    Count c("words string_view   ");
+    vector<string_view> words;
+    string_view w;
+    for (int b = 0; b < batches; b++) {
+        words.clear();
+        arena.reset();
+        for (const string& line : text) {
+            StrReader rdr(line);
+            rdr.use(arena);
+            for (int i = 0; i < words_per_line && rdr(w); i++) {
+                words.push_back(w);
+            }
+        }
+    }
+}
+
+void records_string() {
+    Count c("records string      ");
+    vector<string> recs;
+    StrWriter sw(' ');
+    for (int b = 0; b < batches; b++) {
+        recs.clear();
+        for (int i = 0; i < lines_per_batch; i++) {
+            sw.clear();
+            sw("record")(i)(i*0.5)("status ok");
+            recs.push_back(sw.str());
+        }
+    }
+}
+
+void records_view(Arena& arena) {
+    Count c("records string_view ");
+    vector<string_view> recs;
+    StrWriter sw(' ');
+    for (int b = 0; b < batches; b++) {
+        recs.clear();
+        arena.reset();
+        for (int i = 0; i < lines_per_batch; i++) {
+            sw("record")(i)(i*0.5)("status ok");
+            recs.push_back(sw.take(arena));
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    make_file();
+    vector<string> text;
+    Reader(file).getlines(text);
+    {
+        Arena arena;
+        lines_string();
+        lines_view(arena);
+    }
+    {
+        Arena arena;
+        words_string(text);
+        words_view(text,arena);
+    }
+    {
+        Arena arena;
+        records_string();
+        records_view(arena);
+    }
+    remove(file);
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Lightweight operator() overloading stdio wrapper
+// monotonic arena for string results that live for a batch
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_ARENA_H
+#define __OUTSTREAM_ARENA_H
+#include <cstddef>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <string>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace stream {
+
+/// Arena hands out memory from large blocks and never frees individual
+/// allocations; reset() makes all of it available again at once, keeping
+/// the blocks, so a loop over batches stops allocating after the first one.
+class Arena {
+    struct Block {
+        char *data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t current;
+    char *P;
+    char *P_end;
+    size_t block_size;
+    size_t used_;
+
+    Arena(const Arena&);
+    Arena& operator= (const Arena&);
+
+    // move to the next block with room for n bytes, allocating it if needed
+    void next_block(size_t n) {
+        size_t i = blocks.empty() ? 0 : current + 1;
+        while (i < blocks.size() && blocks[i].size < n) {
+            ++i;
+        }
+        if (i == blocks.size()) {
+            Block b;
+            b.size = n > block_size ? n : block_size;
+            b.data = (char*)malloc(b.size);
+            if (b.data == NULL) throw std::bad_alloc();
+            blocks.push_back(b);
+        }
+        current = i;
+        P = blocks[i].data;
+        P_end = P + blocks[i].size;
+    }
+
+public:
+    Arena(size_t block_size = 64*1024)
+    : current(0), P(NULL), P_end(NULL), block_size(block_size), used_(0)
+    {}
+
+    ~Arena() {
+        release();
+    }
+
+    /// n bytes aligned to `align`, which must be a power of two
+    void *allocate(size_t n, size_t align = alignof(std::max_align_t)) {
+        size_t pad = (align - ((size_t)P & (align-1))) & (align-1);
+        if (P == NULL || pad + n > (size_t)(P_end - P)) {
+            next_block(n + align);
+            pad = (align - ((size_t)P & (align-1))) & (align-1);
+        }
+        char *res = P + pad;
+        P = res + n;
+        used_ += n;
+        return res;
+    }
+
+    /// a NUL-terminated copy of n bytes
+    char *copy(const char *s, size_t n) {
+        char *res = (char*)allocate(n+1,1);
+        memcpy(res,s,n);
+        res[n] = 0;
+        return res;
+    }
+
+    char *copy(const std::string& s) {
+        return copy(s.data(),s.size());
+    }
+
+#if __cplusplus >= 201703L
+    /// copy `s` into the arena; the view is good until reset()
+    std::string_view keep(std::string_view s) {
+        return std::string_view(copy(s.data(),s.size()),s.size());
+    }
+#endif
+
+    /// forget everything allocated, but keep the blocks for reuse
+    void reset() {
+        current = 0;
+        used_ = 0;
+        if (blocks.empty()) {
+            P = P_end = NULL;
+        } else {
+            P = blocks[0].data;
+            P_end = P + blocks[0].size;
+        }
+    }
+
+    /// reset and give the blocks back to the heap
+    void release() {
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            free(blocks[i].data);
+        }
+        blocks.clear();
+        reset();
+    }
+
+    /// bytes handed out since the last reset
+    size_t used() const { return used_; }
+
+    /// bytes held in blocks
+    size_t capacity() const {
+        size_t total = 0;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            total += blocks[i].size;
+        }
+        return total;
+    }
+};
+
+/// a standard allocator drawing from an Arena; deallocate does nothing,
+/// so containers using it are freed all at once by the arena's reset()
+template <class T>
+struct ArenaAllocator {
+    typedef T value_type;
+    Arena *arena;
+
+    ArenaAllocator(Arena& a) : arena(&a) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T *allocate(size_t n) {
+        return (T*)arena->allocate(n*sizeof(T),alignof(T));
+    }
+    void deallocate(T*, size_t) {}
+
+    template <class U>
+    bool operator== (const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <class U>
+    bool operator!= (const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+}
+
+#endif
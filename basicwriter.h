@@ -0,0 +1,398 @@
+// Lightweight operator() overloading stdio wrapper
+// writers with the sink chosen at compile time
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_BASICWRITER_H
+#define __OUTSTREAM_BASICWRITER_H
+#include "outstream.h"
+#include "fastfmt.h"
+#include <memory>
+#include <utility>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace stream {
+
+// A sink is anything with `put(const char*,size_t)`, `put(char)` and `flush()`.
+// These are the ones Writer and its subclasses provide, without the virtual calls.
+
+/// a stdio stream, with our own buffer in front, like Writer's
+class FileSink {
+    FILE *f;
+    bool owner;
+    std::unique_ptr<char[]> buf;
+    size_t size;
+    size_t len;
+
+    void drain() {
+        if (len > 0 && f != nullptr) {
+            fwrite(buf.get(),1,len,f);
+        }
+        len = 0;
+    }
+public:
+    explicit FileSink(FILE *f, size_t size=65536)
+        : f(f), owner(false), buf(new char[size]), size(size), len(0) { }
+    explicit FileSink(const char *file, const char *how="w", size_t size=65536)
+        : f(fopen(file,how)), owner(true), buf(new char[size]), size(size), len(0) { }
+    FileSink(const FileSink&) = delete;
+    ~FileSink() {
+        drain();
+        if (owner && f != nullptr) fclose(f);
+    }
+
+    void put(const char *s, size_t n) {
+        if (n > size - len) {
+            drain();
+            if (n >= size) {
+                fwrite(s,1,n,f);
+                return;
+            }
+        }
+        memcpy(buf.get() + len,s,n);
+        len += n;
+    }
+    void put(char ch) {
+        if (len == size) drain();
+        buf[len++] = ch;
+    }
+    void flush() { drain(); fflush(f); }
+    bool ok() const { return f != nullptr; }
+    FILE *stream() { drain(); return f; }
+};
+
+/// an owned string, like StrWriter's
+class StrSink {
+    std::string s;
+public:
+    explicit StrSink(size_t capacity=0) { s.reserve(capacity); }
+
+    void put(const char *p, size_t n) { s.append(p,n); }
+    void put(char ch) { s.push_back(ch); }
+    void flush() { }
+    bool ok() const { return true; }
+    const std::string& text() const { return s; }
+    void clear() { s.clear(); }
+};
+
+/// a fixed buffer, like BufWriter's: what doesn't fit is dropped, and flush()
+/// adds the NUL, for which there is always room
+class BufSink {
+    char *buff;
+    char *P;
+    char *P_end;
+    size_t size;
+    size_t total;
+public:
+    BufSink(char *buff, size_t size)
+        : buff(buff), P(buff), P_end(buff + (size > 0 ? size - 1 : 0)), size(size), total(0) { }
+
+    void put(const char *s, size_t n) {
+        total += n;
+        size_t room = P_end - P;
+        if (n > room) n = room;
+        memcpy(P,s,n);
+        P += n;
+    }
+    void put(char ch) {
+        ++total;
+        if (P < P_end) *P++ = ch;
+    }
+    void flush() { if (size > 0) *P = '\0'; }
+    bool ok() const { return total == (size_t)(P - buff); }
+    bool truncated() const { return ! ok(); }
+    size_t needed() const { return total; }
+    size_t length() const { return P - buff; }
+    void reset() { P = buff; total = 0; }
+};
+
+/// a file descriptor, written a buffer at a time with no stdio underneath
+class FdSink {
+    int fd;
+    bool owner;
+    std::unique_ptr<char[]> buf;
+    size_t size;
+    size_t len;
+
+    void drain() { write_all(buf.get(),len); len = 0; }
+    void write_all(const char *s, size_t n) {
+        while (n > 0 && fd != -1) {
+            ssize_t res = ::write(fd,s,n);
+            if (res < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            s += res;
+            n -= res;
+        }
+    }
+public:
+    explicit FdSink(int fd, bool own=false, size_t size=65536)
+        : fd(fd), owner(own), buf(new char[size]), size(size), len(0) { }
+    explicit FdSink(const char *file, int flags=O_WRONLY|O_CREAT|O_TRUNC, int mode=0644, size_t size=65536)
+        : fd(::open(file,flags,mode)), owner(true), buf(new char[size]), size(size), len(0) { }
+    FdSink(const FdSink&) = delete;
+    ~FdSink() {
+        drain();
+        if (owner && fd != -1) ::close(fd);
+    }
+
+    void put(const char *s, size_t n) {
+        if (n > size - len) {
+            drain();
+            if (n >= size) {
+                write_all(s,n);
+                return;
+            }
+        }
+        memcpy(buf.get() + len,s,n);
+        len += n;
+    }
+    void put(char ch) {
+        if (len == size) drain();
+        buf[len++] = ch;
+    }
+    void flush() { drain(); }
+    bool ok() const { return fd != -1; }
+    int handle() const { return fd; }
+};
+
+/// any Writer, so every piece of text costs a virtual call again
+class WriterSink {
+    Writer& w;
+public:
+    explicit WriterSink(Writer& w) : w(w) { }
+
+    void put(const char *s, size_t n) { w.raw(s,n); }
+    void put(char ch) { w.raw(&ch,1); }
+    void flush() { w.flush(); }
+    bool ok() { return (bool)w; }
+};
+
+/// SinkWriter is the other way round: a Writer over a sink, for code that
+/// only knows Writer, such as Writeable::write_to
+template <class Sink>
+class SinkWriter: public Writer {
+    Sink& out;
+public:
+    SinkWriter(Sink& out, char sepr=0, bool at_start=true) : Writer(stderr), out(out) {
+        sep(sepr);
+        eoln = at_start;
+    }
+
+    bool at_line_start() const { return eoln; }
+
+    virtual void write_char(char ch) { out.put(ch); }
+    virtual void write_raw(const char *s, size_t n) { out.put(s,n); }
+    virtual void write_out(const char *fmt, va_list ap) {
+        char buf[256];
+        va_list aq;
+        va_copy(aq,ap);
+        int n = vsnprintf(buf,sizeof(buf),fmt,ap);
+        if (n >= (int)sizeof(buf)) {
+            std::string big(n,'\0');
+            vsnprintf(&big[0],n + 1,fmt,aq);
+            out.put(big.data(),n);
+        } else if (n > 0) {
+            out.put(buf,n);
+        }
+        va_end(aq);
+    }
+    virtual Writer& flush() { out.flush(); return *this; }
+};
+
+/// BasicWriter has Writer's operator() interface, but its sink is a template
+/// parameter, so nothing is virtual and a chain like `w(x1)(x2)()` is inlined
+/// down to formatting into the sink's buffer. The sink is built from the
+/// constructor's arguments, as in `BasicWriter<FileSink> w("out.txt")`.
+/// Writer stays as it is, for when the destination is only known at run time.
+template <class Sink>
+class BasicWriter {
+protected:
+    Sink out;
+    char sepc;
+    bool eoln;
+
+    void sep_out() {
+        if (eoln) {
+            eoln = false;
+        } else if (sepc) {
+            out.put(sepc);
+        }
+    }
+
+    BasicWriter& field(const char *s, size_t n) {
+        sep_out();
+        out.put(s,n);
+        return *this;
+    }
+
+    template <class... Args>
+    void printf_out(const char *spec, Args... args) {
+        char buf[64];
+        int n = snprintf(buf,sizeof(buf),spec,args...);
+        if (n < 0) return;
+        if ((size_t)n < sizeof(buf)) {
+            out.put(buf,n);
+        } else {
+            std::string tmp(n,'\0');
+            snprintf(&tmp[0],n + 1,spec,args...);
+            out.put(tmp.data(),n);
+        }
+    }
+
+    template <class T>
+    BasicWriter& formatted(const char *def, const char *fmt, T v) {
+        char copy[30];
+        const char *spec = field_format(def,fmt,copy);
+        sep_out();
+        printf_out(spec,v);
+        return *this;
+    }
+
+    static bool is_hex(const char *fmt) {
+        return (fmt[0] == 'x' || fmt[0] == 'X') && (fmt[1] == 0 || (fmt[1] == fmt[0] && fmt[2] == 0));
+    }
+
+    BasicWriter& hex(uint64_t i, const char *fmt) {
+        char buf[num_buf_size];
+        return field(buf,format_hex(buf,i,fmt[0] == 'X',fmt[1] ? 2 : 1));
+    }
+public:
+    template <class... Args>
+    explicit BasicWriter(Args&&... args) : out(std::forward<Args>(args)...), sepc(0), eoln(true) { }
+    BasicWriter(const BasicWriter&) = delete;
+
+    Sink& sink() { return out; }
+    operator bool () { return out.ok(); }
+
+    BasicWriter& sep(char ch=0) {
+        sepc = ch;
+        return *this;
+    }
+
+    /// write text that is already formatted, with no separator
+    BasicWriter& raw(const char *s, size_t n) {
+        out.put(s,n);
+        return *this;
+    }
+
+    /// like Writer::fmt(), a printf format with no separator
+    template <class... Args>
+    BasicWriter& fmt(const char *spec, Args... args) {
+        printf_out(spec,args...);
+        return *this;
+    }
+
+#if __cplusplus >= 202002L
+    template <FmtString F, typename... Args>
+    BasicWriter& fmt(const Args&... args) {
+        emit_format<F>(*this,args...);
+        return *this;
+    }
+#endif
+
+    BasicWriter& operator() (const char *s, const char *fmt=nullptr) {
+        if (fmt == nullptr && s != nullptr) return field(s,strlen(s));
+        return formatted("%s",fmt,s);
+    }
+
+    BasicWriter& operator() (const std::string& s, const char *fmt=nullptr) {
+        if (fmt == nullptr) return field(s.data(),s.size());
+        return formatted("%s",fmt,s.c_str());
+    }
+
+    BasicWriter& operator() (std::string_view s, const char *fmt=nullptr) {
+        if (fmt == nullptr) return field(s.data(),s.size());
+        return (*this)(std::string(s),fmt);
+    }
+
+    BasicWriter& operator() (int32_t i, const char *fmt=nullptr) {
+        if (fmt != nullptr && ! is_hex(fmt)) return formatted("%" PRIi32,fmt,i);
+        if (fmt != nullptr) return hex((uint32_t)i,fmt);
+        return (*this)((int64_t)i);
+    }
+
+    BasicWriter& operator() (uint32_t i, const char *fmt=nullptr) {
+        if (fmt != nullptr && ! is_hex(fmt)) return formatted("%" PRIu32,fmt,i);
+        return (*this)((uint64_t)i,fmt);
+    }
+
+    BasicWriter& operator() (int64_t i, const char *fmt=nullptr) {
+        char buf[num_buf_size];
+        if (fmt == nullptr) return field(buf,format_i64(buf,i));
+        if (is_hex(fmt)) return hex((uint64_t)i,fmt);
+        return formatted("%" PRIi64,fmt,i);
+    }
+
+    BasicWriter& operator() (uint64_t i, const char *fmt=nullptr) {
+        char buf[num_buf_size];
+        if (fmt == nullptr) return field(buf,format_u64(buf,i));
+        if (is_hex(fmt)) return hex(i,fmt);
+        return formatted("%" PRIu64,fmt,i);
+    }
+
+    BasicWriter& operator() (char ch, const char *fmt=nullptr) {
+        if (ch == '\n' && fmt == nullptr) return (*this)();
+        if (fmt == nullptr) return field(&ch,1);
+        if (is_hex(fmt)) return hex((unsigned char)ch,fmt);
+        return formatted("%c",fmt,ch);
+    }
+
+    BasicWriter& operator() (double x, const char *fmt=nullptr) {
+        char buf[num_buf_size];
+        if (fmt == nullptr) return field(buf,format_g(buf,x));
+        return formatted("%g",fmt,x);
+    }
+
+    BasicWriter& operator() (float x, const char *fmt=nullptr) {
+        return (*this)((double)x,fmt);
+    }
+
+    BasicWriter& operator() (void *p, const char *fmt=nullptr) {
+        return formatted("%p",fmt,p);
+    }
+
+    /// a Writeable writes to a Writer, so it gets one over our sink
+    BasicWriter& operator() (const Writeable& w, const char *fmt=nullptr) {
+        SinkWriter<Sink> sw(out,sepc,eoln);
+        w.write_to(sw,fmt);
+        eoln = sw.at_line_start();
+        return *this;
+    }
+
+    template <class It>
+    BasicWriter& operator() (const Range_<It>& rr, const char *fmt=nullptr, char sepr=' ') {
+        sep_out();
+        char osep = sepc;
+        sepc = sepr;
+        eoln = true;
+        for (It ii = rr.begin; ii != rr.end; ++ii) {
+            (*this)(*ii,fmt);
+        }
+        sepc = osep;
+        return *this;
+    }
+
+    template <class T>
+    BasicWriter& operator() (const std::initializer_list<T>& arr, const char *fmt=nullptr, char sepr=' ') {
+        return (*this)(range(arr),fmt,sepr);
+    }
+
+    /// end of line
+    BasicWriter& operator() () {
+        out.put('\n');
+        eoln = true;
+        return *this;
+    }
+
+    BasicWriter& flush() {
+        out.flush();
+        return *this;
+    }
+};
+
+}
+#endif
@@ -0,0 +1,344 @@
+// Lightweight operator() overloading stdio wrapper
+// binary log records, formatted later
+// Steve Donovan, (c) 2016
+// MIT license
+#include "binlog.h"
+#include <string.h>
+#include <ctype.h>
+using namespace std;
+
+namespace stream {
+
+// Records are a tag byte followed by native-endian data:
+//  c char | r u32 len, bytes | i int64 | u uint64 | x,X uint64 | g double
+//  F u32 id, u32 len, format text | f u32 id, then the arguments for each piece:
+//    an int for each star, then i int | l long | L long long | z size_t |
+//    d double | D long double | p pointer | s u32 len, bytes
+
+static bool is_flag(char c) {
+    return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0' || c == '\'' || c == 'I';
+}
+
+bool split_format(const char *fmt, FormatPieces& pieces) {
+    FormatPiece piece = {"",0,0};
+    const char *P = fmt;
+    while (*P) {
+        if (*P != '%') {
+            piece.text += *P++;
+            continue;
+        }
+        if (P[1] == '%') {
+            piece.text += "%%";
+            P += 2;
+            continue;
+        }
+        piece.text += *P++;
+        while (is_flag(*P)) {
+            piece.text += *P++;
+        }
+        if (*P == '*') {
+            piece.text += *P++;
+            ++piece.stars;
+        }
+        while (isdigit(*P)) {
+            piece.text += *P++;
+        }
+        if (*P == '.') {
+            piece.text += *P++;
+            if (*P == '*') {
+                piece.text += *P++;
+                ++piece.stars;
+            }
+            while (isdigit(*P)) {
+                piece.text += *P++;
+            }
+        }
+        int longs = 0;
+        bool big = false;
+        while (*P && strchr("hlLqjzt",*P)) {
+            if (*P == 'l') ++longs;
+            if (*P == 'L' || *P == 'q' || *P == 'j') longs = 2;
+            if (*P == 'L') big = true;
+            if (*P == 'z') longs = 3;
+            if (*P == 't') longs = 1;
+            piece.text += *P++;
+        }
+        char conv = *P;
+        if (conv == 0) return false;
+        piece.text += *P++;
+        if (strchr("diouxXc",conv)) {
+            const char types[] = "ilLz";
+            piece.type = types[longs];
+        } else
+        if (strchr("fFeEgGaA",conv)) {
+            piece.type = big ? 'D' : 'd';
+        } else
+        if (conv == 's' && longs == 0) {
+            piece.type = 's';
+        } else
+        if (conv == 'p') {
+            piece.type = 'p';
+        } else { // %n, wide strings, or %m which depends on errno
+            return false;
+        }
+        pieces.push_back(piece);
+        piece.text.clear();
+        piece.stars = 0;
+        piece.type = 0;
+    }
+    if (! piece.text.empty()) {
+        pieces.push_back(piece);
+    }
+    return true;
+}
+
+BinWriter::BinWriter(const char *file) : Writer(file,"wb") {
+}
+
+void BinWriter::record(char tag, const void *data, size_t n) {
+    rec.clear();
+    rec += tag;
+    rec.append((const char*)data,n);
+    Writer::write_raw(rec.data(),rec.size());
+}
+
+template <class T>
+static void put(string& rec, T val) {
+    rec.append((const char*)&val,sizeof(T));
+}
+
+// formats are usually literals, so are looked up by address;
+// the text is checked in case the address was a reused buffer
+size_t BinWriter::format_id(const char *fmt) {
+    map<const char*,size_t>::iterator it = format_ids.find(fmt);
+    if (it != format_ids.end() && formats[it->second].text == fmt) {
+        return it->second;
+    }
+    size_t id = formats.size();
+    formats.push_back(Format());
+    Format& f = formats.back();
+    f.text = fmt;
+    f.ok = split_format(fmt,f.pieces);
+    format_ids[fmt] = id;
+    // the decoder expects ids in order, so one that can't be deferred
+    // still gets a record, with no text
+    size_t len = f.ok ? f.text.size() : 0;
+    rec.clear();
+    rec += 'F';
+    put(rec,(uint32_t)id);
+    put(rec,(uint32_t)len);
+    rec.append(f.text,0,len);
+    Writer::write_raw(rec.data(),rec.size());
+    return id;
+}
+
+void BinWriter::write_char(char ch) {
+    record('c',&ch,1);
+}
+
+void BinWriter::write_raw(const char *s, size_t n) {
+    rec.clear();
+    rec += 'r';
+    put(rec,(uint32_t)n);
+    rec.append(s,n);
+    Writer::write_raw(rec.data(),rec.size());
+}
+
+void BinWriter::write_out(const char *fmt, va_list ap) {
+    size_t id = format_id(fmt);
+    Format& f = formats[id];
+    if (! f.ok) { // can't be deferred, so format it now
+        va_list aq;
+        va_copy(aq,ap);
+        int n = vsnprintf(nullptr,0,fmt,ap);
+        string text(n > 0 ? n : 0,'\0');
+        vsnprintf(&text[0],n+1,fmt,aq);
+        va_end(aq);
+        write_raw(text.data(),text.size());
+        return;
+    }
+    rec.clear();
+    rec += 'f';
+    put(rec,(uint32_t)id);
+    for (size_t i = 0; i < f.pieces.size(); ++i) {
+        const FormatPiece& p = f.pieces[i];
+        for (int s = 0; s < p.stars; ++s) {
+            put(rec,va_arg(ap,int));
+        }
+        switch (p.type) {
+        case 'i': put(rec,va_arg(ap,int)); break;
+        case 'l': put(rec,va_arg(ap,long)); break;
+        case 'L': put(rec,va_arg(ap,long long)); break;
+        case 'z': put(rec,va_arg(ap,size_t)); break;
+        case 'd': put(rec,va_arg(ap,double)); break;
+        case 'D': put(rec,va_arg(ap,long double)); break;
+        case 'p': put(rec,va_arg(ap,void*)); break;
+        case 's': {
+            const char *s = va_arg(ap,const char*);
+            if (s == nullptr) s = "(null)";
+            uint32_t len = strlen(s);
+            put(rec,len);
+            rec.append(s,len);
+            break;
+        }
+        }
+    }
+    Writer::write_raw(rec.data(),rec.size());
+}
+
+Writer& BinWriter::int_field(int64_t i) {
+    sep_out();
+    record('i',&i,sizeof(i));
+    return *this;
+}
+
+Writer& BinWriter::uint_field(uint64_t i) {
+    sep_out();
+    record('u',&i,sizeof(i));
+    return *this;
+}
+
+// two-digit hex is tagged with the next letter along
+Writer& BinWriter::hex_field(uint64_t i, const char *fmt) {
+    sep_out();
+    record(fmt[1] ? fmt[0] + 1 : fmt[0],&i,sizeof(i));
+    return *this;
+}
+
+// the numbers are recorded one by one, like any others
+Writer& BinWriter::number_run(const void *p, size_t n, size_t width, char kind, const char *fmt) {
+    return each_number(p,n,width,kind,fmt);
+}
+
+Writer& BinWriter::double_field(double x) {
+    sep_out();
+    record('g',&x,sizeof(x));
+    return *this;
+}
+
+//// decoding ////
+
+template <class T>
+static void print_piece(Writer& out, const FormatPiece& p, const int *stars, T val) {
+    const char *fmt = p.text.c_str();
+    if (p.stars == 0) {
+        fmt_detail::printf_field(out,fmt,val);
+    } else
+    if (p.stars == 1) {
+        fmt_detail::printf_field(out,fmt,stars[0],val);
+    } else {
+        fmt_detail::printf_field(out,fmt,stars[0],stars[1],val);
+    }
+}
+
+template <class T>
+static void print_arg(Reader& in, Writer& out, const FormatPiece& p, const int *stars) {
+    T val;
+    if (in.read(val)) {
+        print_piece(out,p,stars,val);
+    }
+}
+
+static bool decode_format(Reader& in, Writer& out, const FormatPieces& pieces) {
+    string s;
+    for (size_t i = 0; i < pieces.size() && in; ++i) {
+        const FormatPiece& p = pieces[i];
+        int stars[2];
+        for (int s = 0; s < p.stars; ++s) {
+            in.read(stars[s]);
+        }
+        switch (p.type) {
+        case 0: fmt_detail::printf_field(out,p.text.c_str()); break;
+        case 'i': print_arg<int>(in,out,p,stars); break;
+        case 'l': print_arg<long>(in,out,p,stars); break;
+        case 'L': print_arg<long long>(in,out,p,stars); break;
+        case 'z': print_arg<size_t>(in,out,p,stars); break;
+        case 'd': print_arg<double>(in,out,p,stars); break;
+        case 'D': print_arg<long double>(in,out,p,stars); break;
+        case 'p': print_arg<void*>(in,out,p,stars); break;
+        case 's': {
+            uint32_t len;
+            if (in.read(len)) {
+                s.resize(len);
+                if (in.read(&s[0],len) == len) {
+                    print_piece(out,p,stars,s.c_str());
+                }
+            }
+            break;
+        }
+        }
+    }
+    return in;
+}
+
+bool decode_binlog(Reader& in, Writer& out) {
+    vector<FormatPieces> formats;
+    string text;
+    char buf[num_buf_size];
+    char tag;
+    while (in.read(&tag,1) == 1) {
+        switch (tag) {
+        case 'c': {
+            char ch;
+            if (in.read(ch)) out.raw(&ch,1);
+            break;
+        }
+        case 'r':
+        case 'F': {
+            uint32_t id = 0, len;
+            if (tag == 'F') in.read(id);
+            if (! in.read(len)) break;
+            text.resize(len);
+            if (len > 0 && in.read(&text[0],len) != len) {
+                return false;
+            }
+            if (tag == 'r') {
+                out.raw(text.data(),len);
+            } else {
+                if (id != formats.size()) return false;
+                formats.push_back(FormatPieces());
+                split_format(text.c_str(),formats.back());
+            }
+            break;
+        }
+        case 'f': {
+            uint32_t id;
+            if (! in.read(id) || id >= formats.size()) return false;
+            if (! decode_format(in,out,formats[id])) return false;
+            break;
+        }
+        case 'i': {
+            int64_t i;
+            if (in.read(i)) out.raw(buf,format_i64(buf,i));
+            break;
+        }
+        case 'u': {
+            uint64_t u;
+            if (in.read(u)) out.raw(buf,format_u64(buf,u));
+            break;
+        }
+        case 'x':
+        case 'X':
+        case 'y':
+        case 'Y': {
+            uint64_t u;
+            bool two = tag == 'y' || tag == 'Y';
+            if (in.read(u)) out.raw(buf,format_hex(buf,u,tag == 'X' || tag == 'Y',two ? 2 : 1));
+            break;
+        }
+        case 'g': {
+            double x;
+            if (in.read(x)) out.raw(buf,format_g(buf,x));
+            break;
+        }
+        default:
+            return false;
+        }
+        if (! in) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,65 @@
+// Lightweight operator() overloading stdio wrapper
+// binary log records, formatted later
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_BINLOG_H
+#define __OUTSTREAM_BINLOG_H
+#include "outstream.h"
+#include "instream.h"
+#include <map>
+#include <vector>
+
+namespace stream {
+
+/// a printf format split into pieces with at most one conversion each
+struct FormatPiece {
+    std::string text;   // NUL-terminated format for this piece
+    int stars;          // number of '*' width/precision arguments
+    char type;          // argument type tag, 0 if no conversion
+};
+
+typedef std::vector<FormatPiece> FormatPieces;
+
+/// split `fmt`; false if it uses a conversion we cannot record, like %n
+bool split_format(const char *fmt, FormatPieces& pieces);
+
+/// BinWriter records what would have been written as compact binary records:
+/// numbers with the default format keep their raw bytes, and formatted fields
+/// keep their arguments together with the id of the format, which is written once.
+/// Nothing is converted to text until decode_binlog is called, usually somewhere else.
+class BinWriter: public Writer {
+protected:
+    struct Format {
+        std::string text;
+        FormatPieces pieces;
+        bool ok;
+    };
+    std::vector<Format> formats;
+    std::map<const char*,size_t> format_ids;
+    std::string rec;
+
+    size_t format_id(const char *fmt);
+    void record(char tag, const void *data, size_t n);
+
+    virtual Writer& int_field(int64_t i);
+    virtual Writer& uint_field(uint64_t i);
+    virtual Writer& hex_field(uint64_t i, const char *fmt);
+    virtual Writer& double_field(double x);
+    virtual Writer& number_run(const void *p, size_t n, size_t width, char kind, const char *fmt);
+
+public:
+    BinWriter(const char *file);
+
+    virtual void write_char(char ch);
+    virtual void write_out(const char *fmt, va_list ap);
+    virtual void write_raw(const char *s, size_t n);
+};
+
+/// turn the records read from `in` back into exactly the text the original
+/// writes would have produced; false if the log is damaged
+bool decode_binlog(Reader& in, Writer& out);
+
+}
+
+#endif
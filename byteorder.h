@@ -0,0 +1,70 @@
+// Lightweight operator() overloading stdio wrapper
+// byte order of binary records
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_BYTEORDER_H
+#define __OUTSTREAM_BYTEORDER_H
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace stream {
+
+/// the byte order of numbers in a binary file; native means as they are in memory
+enum Endian { native_endian, little_endian, big_endian };
+
+/// bulk reads and writes of records go a block of this many bytes at a time
+const size_t record_block = 4*1024*1024;
+
+/// whether numbers in `order` have their bytes the other way round from ours
+inline bool byte_swapped(Endian order) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return order == little_endian;
+#else
+    return order == big_endian;
+#endif
+}
+
+/// reverse the bytes of each of the `n` values of `width` bytes at `p`
+inline void swap_bytes(void *p, size_t n, size_t width) {
+    char *P = (char*)p;
+    switch (width) {
+    case 1:
+        return;
+    case 2:
+        for (size_t i = 0; i < n; ++i, P += 2) {
+            uint16_t v;
+            memcpy(&v,P,2);
+            v = __builtin_bswap16(v);
+            memcpy(P,&v,2);
+        }
+        return;
+    case 4:
+        for (size_t i = 0; i < n; ++i, P += 4) {
+            uint32_t v;
+            memcpy(&v,P,4);
+            v = __builtin_bswap32(v);
+            memcpy(P,&v,4);
+        }
+        return;
+    case 8:
+        for (size_t i = 0; i < n; ++i, P += 8) {
+            uint64_t v;
+            memcpy(&v,P,8);
+            v = __builtin_bswap64(v);
+            memcpy(P,&v,8);
+        }
+        return;
+    }
+    for (size_t i = 0; i < n; ++i, P += width) {
+        for (size_t a = 0, b = width - 1; a < b; ++a, --b) {
+            char t = P[a];
+            P[a] = P[b];
+            P[b] = t;
+        }
+    }
+}
+
+}
+#endif
@@ -0,0 +1,420 @@
+// Lightweight operator() overloading stdio wrapper
+// compressed files as ordinary stdio streams
+// Steve Donovan, (c) 2016
+// MIT license
+#include "compress.h"
+#include <errno.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace stream {
+
+// the caller and the background thread each have a block of this size
+const size_t compress_block = 1024*1024;
+
+// reading compressed input a piece at a time
+const size_t compress_input = 65536;
+
+// the compression itself; ZFile below does the threading
+class Codec {
+public:
+    /// an errno value once something has gone wrong; EBADMSG for bad compressed data
+    int err = 0;
+
+    virtual ~Codec() { }
+    /// compress `n` bytes into `out`, ending the stream if `finish`
+    virtual bool compress(const char *p, size_t n, bool finish, FILE *out) = 0;
+    /// up to `cap` bytes decompressed from `in`; 0 at the end, -1 on error.
+    /// What came out before an error is returned first, and -1 by the next call
+    virtual long decompress(char *buf, size_t cap, FILE *in) = 0;
+
+protected:
+    long decompress_error(int e, long have) {
+        err = e;
+        return have > 0 ? have : -1;
+    }
+};
+
+class GzipCodec: public Codec {
+    z_stream z;
+    bool writing;
+    bool done;
+    char io[compress_input];
+public:
+    GzipCodec(bool writing, int level) : writing(writing), done(false) {
+        memset(&z,0,sizeof(z));
+        // 16 asks for a gzip header; 32 accepts either gzip or zlib
+        if (writing) {
+            deflateInit2(&z,level,Z_DEFLATED,15 + 16,8,Z_DEFAULT_STRATEGY);
+        } else {
+            inflateInit2(&z,15 + 32);
+        }
+    }
+
+    ~GzipCodec() {
+        if (writing) {
+            deflateEnd(&z);
+        } else {
+            inflateEnd(&z);
+        }
+    }
+
+    bool compress(const char *p, size_t n, bool finish, FILE *out) {
+        z.next_in = (Bytef*)p;
+        z.avail_in = n;
+        int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+        int res;
+        do {
+            z.next_out = (Bytef*)io;
+            z.avail_out = sizeof(io);
+            res = deflate(&z,flush);
+            if (res == Z_STREAM_ERROR) {
+                err = EINVAL;
+                return false;
+            }
+            size_t have = sizeof(io) - z.avail_out;
+            if (have > 0 && fwrite(io,1,have,out) != have) {
+                err = errno;
+                return false;
+            }
+        } while (z.avail_out == 0 || (finish && res != Z_STREAM_END));
+        return true;
+    }
+
+    // a member that ends with more input after it is followed by another one
+    long decompress(char *buf, size_t cap, FILE *in) {
+        if (err != 0) return -1;
+        z.next_out = (Bytef*)buf;
+        z.avail_out = cap;
+        while (z.avail_out > 0 && ! done) {
+            if (z.avail_in == 0) {
+                z.avail_in = fread(io,1,sizeof(io),in);
+                z.next_in = (Bytef*)io;
+                if (z.avail_in == 0) {
+                    return decompress_error(ferror(in) ? errno : EBADMSG,cap - z.avail_out);
+                }
+            }
+            int res = inflate(&z,Z_NO_FLUSH);
+            if (res == Z_STREAM_END) {
+                if (z.avail_in == 0) {
+                    z.avail_in = fread(io,1,sizeof(io),in);
+                    z.next_in = (Bytef*)io;
+                }
+                if (z.avail_in == 0) {
+                    done = true;
+                } else {
+                    inflateReset(&z);
+                }
+            } else if (res != Z_OK && res != Z_BUF_ERROR) {
+                return decompress_error(EBADMSG,cap - z.avail_out);
+            }
+        }
+        return cap - z.avail_out;
+    }
+};
+
+#ifdef HAVE_ZSTD
+class ZstdCodec: public Codec {
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+    ZSTD_inBuffer zin;
+    size_t last;   // the last hint from ZSTD_decompressStream; 0 at the end of a frame
+    char io[compress_input];
+public:
+    ZstdCodec(bool writing, int level) : cctx(nullptr), dctx(nullptr), last(0) {
+        if (writing) {
+            cctx = ZSTD_createCCtx();
+            ZSTD_CCtx_setParameter(cctx,ZSTD_c_compressionLevel,level == -1 ? ZSTD_CLEVEL_DEFAULT : level);
+        } else {
+            dctx = ZSTD_createDCtx();
+        }
+        zin.src = io;
+        zin.size = 0;
+        zin.pos = 0;
+    }
+
+    ~ZstdCodec() {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+
+    bool compress(const char *p, size_t n, bool finish, FILE *out) {
+        ZSTD_inBuffer src = {p,n,0};
+        ZSTD_EndDirective mode = finish ? ZSTD_e_end : ZSTD_e_continue;
+        size_t left;
+        do {
+            ZSTD_outBuffer dest = {io,sizeof(io),0};
+            left = ZSTD_compressStream2(cctx,&dest,&src,mode);
+            if (ZSTD_isError(left)) {
+                err = EINVAL;
+                return false;
+            }
+            if (dest.pos > 0 && fwrite(io,1,dest.pos,out) != dest.pos) {
+                err = errno;
+                return false;
+            }
+        } while (finish ? left != 0 : src.pos < src.size);
+        return true;
+    }
+
+    long decompress(char *buf, size_t cap, FILE *in) {
+        if (err != 0) return -1;
+        ZSTD_outBuffer dest = {buf,cap,0};
+        while (dest.pos < dest.size) {
+            if (zin.pos == zin.size) {
+                zin.size = fread(io,1,sizeof(io),in);
+                zin.pos = 0;
+                if (zin.size == 0) {
+                    if (ferror(in)) {
+                        return decompress_error(errno,dest.pos);
+                    }
+                    if (last != 0) {
+                        return decompress_error(EBADMSG,dest.pos);
+                    }
+                    break;
+                }
+            }
+            last = ZSTD_decompressStream(dctx,&dest,&zin);
+            if (ZSTD_isError(last)) {
+                return decompress_error(EBADMSG,dest.pos);
+            }
+        }
+        return dest.pos;
+    }
+};
+#endif
+
+// The cookie behind a compressed FILE. The caller's block (front) is filled, or
+// drained, while the background thread works on the other one (back); they are
+// swapped when both sides are ready.
+class ZFile {
+    Codec *codec;
+    FILE *file;
+    bool writing;
+    std::vector<char> front, back;
+    size_t front_pos, front_len, back_len;
+    bool back_full;   // writing: a block for the thread; reading: one for the caller
+    bool finish;
+    bool stop;
+    std::atomic<bool> failed;   // checked by write() without the lock
+    std::mutex m;
+    std::condition_variable cv;
+    std::thread worker;
+
+    void hand_over(bool last) {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock,[this] { return ! back_full; });
+        front.swap(back);
+        back_len = front_len;
+        front_len = 0;
+        finish = last;
+        back_full = true;
+        cv.notify_all();
+    }
+
+    void compressing() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock,[this] { return back_full; });
+            }
+            bool ok = ! failed && codec->compress(back.data(),back_len,finish,file);
+            std::lock_guard<std::mutex> lock(m);
+            failed = ! ok;
+            back_full = false;
+            cv.notify_all();
+            if (finish) return;
+        }
+    }
+
+    void decompressing() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock,[this] { return ! back_full || stop; });
+                if (stop) return;
+            }
+            long n = codec->decompress(back.data(),back.size(),file);
+            std::lock_guard<std::mutex> lock(m);
+            back_len = n > 0 ? n : 0;
+            failed = n < 0;
+            back_full = true;
+            cv.notify_all();
+            if (n <= 0) return;
+        }
+    }
+
+public:
+    ZFile(Codec *codec, FILE *file, bool writing)
+        : codec(codec), file(file), writing(writing), front(compress_block), back(compress_block),
+          front_pos(0), front_len(0), back_len(0), back_full(false), finish(false), stop(false), failed(false)
+    {
+        if (writing) {
+            worker = std::thread(&ZFile::compressing,this);
+        } else {
+            worker = std::thread(&ZFile::decompressing,this);
+        }
+    }
+
+    ssize_t write(const char *buf, size_t size) {
+        if (failed) {
+            errno = codec->err;
+            return -1;
+        }
+        size_t left = size;
+        while (left > 0) {
+            size_t n = std::min(left,compress_block - front_len);
+            memcpy(front.data() + front_len,buf,n);
+            front_len += n;
+            buf += n;
+            left -= n;
+            if (front_len == compress_block) {
+                hand_over(false);
+            }
+        }
+        return size;
+    }
+
+    // the thread leaves back_full set at the end, so every later read is 0 too
+    ssize_t read(char *buf, size_t size) {
+        if (front_pos == front_len) {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock,[this] { return back_full; });
+            if (back_len == 0) {
+                if (failed) {
+                    errno = codec->err;
+                    return -1;
+                }
+                return 0;
+            }
+            front.swap(back);
+            front_len = back_len;
+            front_pos = 0;
+            back_full = false;
+            cv.notify_all();
+        }
+        size_t n = std::min(size,front_len - front_pos);
+        memcpy(buf,front.data() + front_pos,n);
+        front_pos += n;
+        return n;
+    }
+
+    int close() {
+        if (writing) {
+            hand_over(true);
+        } else {
+            std::lock_guard<std::mutex> lock(m);
+            stop = true;
+            cv.notify_all();
+        }
+        worker.join();
+        bool ok = ! failed;
+        if (fclose(file) != 0) {
+            ok = false;
+        } else if (! ok) {
+            errno = codec->err;
+        }
+        delete codec;
+        return ok ? 0 : EOF;
+    }
+};
+
+static ssize_t zfile_read(void *cookie, char *buf, size_t size) {
+    return ((ZFile*)cookie)->read(buf,size);
+}
+
+static ssize_t zfile_write(void *cookie, const char *buf, size_t size) {
+    return ((ZFile*)cookie)->write(buf,size);
+}
+
+static int zfile_close(void *cookie) {
+    ZFile *zf = (ZFile*)cookie;
+    int res = zf->close();
+    delete zf;
+    return res;
+}
+
+static bool ends_with(const char *s, const char *ext) {
+    size_t n = strlen(s), m = strlen(ext);
+    return n > m && strcmp(s + n - m,ext) == 0;
+}
+
+Compression compression_of(const char *file) {
+    if (ends_with(file,".gz")) return compress_gzip;
+    if (ends_with(file,".zst")) return compress_zstd;
+    return compress_none;
+}
+
+FILE *zopen(const char *file, const char *how, Compression kind, int level) {
+    if (kind == compress_by_name) {
+        kind = compression_of(file);
+    }
+    if (kind == compress_none) {
+        return fopen(file,how);
+    }
+#ifndef HAVE_ZSTD
+    if (kind == compress_zstd) {
+        errno = ENOTSUP;
+        return nullptr;
+    }
+#endif
+    bool writing = how[0] != 'r';
+    FILE *f = fopen(file,writing ? (how[0] == 'a' ? "ab" : "wb") : "rb");
+    if (f == nullptr) {
+        return nullptr;
+    }
+    Codec *codec;
+#ifdef HAVE_ZSTD
+    if (kind == compress_zstd) {
+        codec = new ZstdCodec(writing,level);
+    } else
+#endif
+    codec = new GzipCodec(writing,level);
+    cookie_io_functions_t io = {zfile_read, zfile_write, nullptr, zfile_close};
+    ZFile *zf = new ZFile(codec,f,writing);
+    FILE *res = fopencookie(zf,writing ? "w" : "r",io);
+    if (res == nullptr) {
+        zfile_close(zf);
+        return nullptr;
+    }
+    setvbuf(res,nullptr,_IOFBF,compress_input);
+    return res;
+}
+
+// formatting goes into the Writer's buffer, so the stream sees big pieces
+ZWriter::ZWriter(const char *file, Compression kind, int level, const char *how)
+    : Writer(zopen(file,how,kind,level))
+{
+    owner = true;
+    buffering(compress_input,false);
+}
+
+ZWriter::ZWriter(const std::string& file, Compression kind, int level, const char *how)
+    : ZWriter(file.c_str(),kind,level,how)
+{
+}
+
+ZReader::ZReader(const char *file, Compression kind)
+    : Reader((FILE*)nullptr)
+{
+    FILE *f = zopen(file,"r",kind);
+    if (f == nullptr) {
+        set_error(strerror(errno),errno);
+    } else {
+        set(f,true);
+    }
+}
+
+ZReader::ZReader(const std::string& file, Compression kind)
+    : ZReader(file.c_str(),kind)
+{
+}
+
+}
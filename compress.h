@@ -0,0 +1,44 @@
+// Lightweight operator() overloading stdio wrapper
+// compressed files as ordinary stdio streams
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_COMPRESS_H
+#define __OUTSTREAM_COMPRESS_H
+#include "outstream.h"
+#include "instream.h"
+
+namespace stream {
+
+/// compress_by_name goes by the file's extension: ".gz" is gzip, ".zst" is zstd
+/// (if built with HAVE_ZSTD), and anything else is left alone
+enum Compression { compress_by_name, compress_none, compress_gzip, compress_zstd };
+
+/// the compression that `file`'s extension asks for
+Compression compression_of(const char *file);
+
+/// open `file` as a stdio stream that compresses what is written ("w" or "a") or
+/// decompresses what is read ("r"). The compressing and decompressing is done a
+/// block at a time by a background thread, so it overlaps with formatting and
+/// parsing. `level` is zlib's 1-9 or zstd's 1-19; -1 is the library's default.
+/// Returns null with errno set if the file can't be opened, or the compression
+/// isn't supported.
+FILE *zopen(const char *file, const char *how, Compression kind=compress_by_name, int level=-1);
+
+/// ZWriter writes a compressed file, through its own buffer
+class ZWriter: public Writer {
+public:
+    ZWriter(const char *file, Compression kind=compress_by_name, int level=-1, const char *how="w");
+    ZWriter(const std::string& file, Compression kind=compress_by_name, int level=-1, const char *how="w");
+};
+
+/// ZReader reads a compressed file; gzip input may be several gzip members one
+/// after the other, as `cat a.gz b.gz` gives, and zstd input several frames
+class ZReader: public Reader {
+public:
+    ZReader(const char *file, Compression kind=compress_by_name);
+    ZReader(const std::string& file, Compression kind=compress_by_name);
+};
+
+}
+#endif
@@ -0,0 +1,159 @@
+// Lightweight operator() overloading stdio wrapper
+// Writer for many threads, without a shared lock
+// Steve Donovan, (c) 2016
+// MIT license
+#include "concurrent.h"
+#include <algorithm>
+#include <vector>
+#include <set>
+#include <chrono>
+using namespace std;
+
+namespace stream {
+
+void ring_backoff(int& tries) {
+    ++tries;
+    if (tries < 64) {
+        return;
+    } else
+    if (tries < 128) {
+        this_thread::yield();
+    } else {
+        this_thread::sleep_for(chrono::microseconds(50));
+    }
+}
+
+// each thread's line-assembly buffer
+class LineWriter: public StrWriter {
+    ConcurrentWriter *cw;
+public:
+    LineWriter(ConcurrentWriter *cw, char sepr) : StrWriter(sepr), cw(cw) {}
+
+    virtual void put_eoln() {
+        s += '\n';
+        cw->publish(s);
+        s.clear();
+    }
+};
+
+static atomic<uint64_t> next_id(1);
+
+// writers are looked up by id rather than address, since a new
+// ConcurrentWriter may be created where an old one used to be
+static thread_local vector<pair<uint64_t,unique_ptr<LineWriter>>> local_writers;
+
+// the ids of the writers still alive, so that a thread can drop the
+// line writers of those that have gone
+static mutex& live_lock() {
+    static mutex m;
+    return m;
+}
+
+static set<uint64_t>& live_ids() {
+    static set<uint64_t> ids;
+    return ids;
+}
+
+ConcurrentWriter::ConcurrentWriter(Writer& target, char sep, size_t ring_size)
+    : target(target), sepc(sep), ring(ring_size), id(next_id++),
+      published(0), written(0), done(false), sleeping(false), flusher(&ConcurrentWriter::run,this)
+{
+    lock_guard<mutex> lock(live_lock());
+    live_ids().insert(id);
+}
+
+ConcurrentWriter::~ConcurrentWriter() {
+    {
+        lock_guard<mutex> lock(live_lock());
+        live_ids().erase(id);
+    }
+    done.store(true);
+    {
+        lock_guard<mutex> lock(wake_lock);
+        wake.notify_one();
+    }
+    flusher.join();
+}
+
+// a thread's first line for this writer is also when it prunes the others
+Writer& ConcurrentWriter::local() {
+    for (auto& lw : local_writers) {
+        if (lw.first == id) {
+            return *lw.second;
+        }
+    }
+    {
+        lock_guard<mutex> lock(live_lock());
+        set<uint64_t>& live = live_ids();
+        local_writers.erase(remove_if(local_writers.begin(),local_writers.end(),
+            [&](const pair<uint64_t,unique_ptr<LineWriter>>& lw) { return live.count(lw.first) == 0; }),
+            local_writers.end());
+    }
+    local_writers.emplace_back(id,unique_ptr<LineWriter>(new LineWriter(this,sepc)));
+    return *local_writers.back().second;
+}
+
+void ConcurrentWriter::publish(string& line) {
+    int tries = 0;
+    while (! ring.push(line)) {
+        ring_backoff(tries);
+    }
+    published.fetch_add(1);
+    if (sleeping.load()) {
+        lock_guard<mutex> lock(wake_lock);
+        wake.notify_one();
+    }
+}
+
+// `sleeping` is set before the last look, and read after each publish, so a
+// line published meanwhile either is seen here or wakes us
+void ConcurrentWriter::idle(uint64_t n) {
+    unique_lock<mutex> lock(wake_lock);
+    sleeping.store(true);
+    wake.wait(lock,[&] { return published.load() != n || done.load(); });
+    sleeping.store(false);
+}
+
+// the single consumer. The target is flushed whenever the ring runs dry,
+// or after a ring's worth of lines under constant load
+void ConcurrentWriter::run() {
+    string line;
+    uint64_t n = 0, last_flush = 0;
+    int tries = 0;
+    for (;;) {
+        if (ring.pop(line)) {
+            target.raw(line.data(),line.size());
+            line.clear();
+            ++n;
+            tries = 0;
+            if (n - last_flush < ring.capacity()) {
+                continue;
+            }
+        }
+        if (n != last_flush) {
+            target.flush();
+            last_flush = n;
+            written.store(n,memory_order_release);
+            continue;
+        }
+        if (done.load(memory_order_acquire) && published.load(memory_order_acquire) == n) {
+            break;
+        }
+        if (tries < 128) {
+            ring_backoff(tries);
+        } else {
+            idle(n);
+            tries = 0;
+        }
+    }
+}
+
+void ConcurrentWriter::flush() {
+    uint64_t n = published.load(memory_order_acquire);
+    int tries = 0;
+    while (written.load(memory_order_acquire) < n) {
+        ring_backoff(tries);
+    }
+}
+
+}
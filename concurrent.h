@@ -0,0 +1,125 @@
+// Lightweight operator() overloading stdio wrapper
+// Writer for many threads, without a shared lock
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_CONCURRENT_H
+#define __OUTSTREAM_CONCURRENT_H
+#include "outstream.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace stream {
+
+/// A bounded multi-producer, single-consumer ring (after Dmitry Vyukov's
+/// bounded queue). Items are swapped in and out, so that strings keep
+/// their capacity as they go round. Neither side ever takes a lock.
+template <class T>
+class MpscRing {
+    struct Slot {
+        std::atomic<size_t> seq;
+        T item;
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) size_t tail;
+
+public:
+    /// size is rounded up to a power of two
+    MpscRing(size_t size) : tail(0) {
+        size_t n = 2;
+        while (n < size) n *= 2;
+        slots.reset(new Slot[n]);
+        mask = n - 1;
+        for (size_t i = 0; i < n; ++i) {
+            slots[i].seq.store(i,std::memory_order_relaxed);
+        }
+        head.store(0,std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    /// swap `item` into the ring; false if it is full
+    bool push(T& item) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos & mask];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed)) {
+                    std::swap(slot.item,item);
+                    slot.seq.store(pos+1,std::memory_order_release);
+                    return true;
+                }
+            } else
+            if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// swap the oldest item out of the ring; false if it is empty.
+    /// Only one thread may pop.
+    bool pop(T& item) {
+        Slot& slot = slots[tail & mask];
+        size_t seq = slot.seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(tail+1) < 0) {
+            return false;
+        }
+        std::swap(slot.item,item);
+        slot.seq.store(tail + mask + 1,std::memory_order_release);
+        ++tail;
+        return true;
+    }
+};
+
+/// back off while waiting on a ring: spin, then yield, then sleep
+void ring_backoff(int& tries);
+
+class LineWriter;
+
+/// ConcurrentWriter gives each thread its own Writer through local().
+/// Fields are assembled into a thread-local line, and each completed line is
+/// published to a lock-free ring; one background thread writes the lines
+/// to the target, which nobody else should use meanwhile.
+/// A partial line left when a thread exits is discarded.
+class ConcurrentWriter {
+    Writer& target;
+    char sepc;
+    MpscRing<std::string> ring;
+    uint64_t id;
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> written;
+    std::atomic<bool> done;
+    std::atomic<bool> sleeping;   // the flusher waits on `wake` when there is nothing to do
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    std::thread flusher;
+
+    void run();
+    void idle(uint64_t n);
+    friend class LineWriter;
+    void publish(std::string& line);
+
+public:
+    ConcurrentWriter(Writer& target, char sep=' ', size_t ring_size=4096);
+    ~ConcurrentWriter();
+
+    /// the Writer for the calling thread
+    Writer& local();
+
+    /// wait until every line published so far has been written and flushed
+    void flush();
+};
+
+}
+
+#endif
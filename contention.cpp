@@ -0,0 +1,96 @@
+// how logging from many threads scales: a ConcurrentWriter against
+// a single Writer guarded by a mutex
+#include "concurrent.h"
+#include <mutex>
+#include <vector>
+#include <time.h>
+using namespace std;
+using namespace stream;
+
+static uint64_t millisecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    return 1000L*ts.tv_sec + ts.tv_nsec/1000000L;
+}
+
+const int N = 2000000;
+const char *file = "contention.dat";
+
+void run_threads(int nthreads, void (*work)(int,int)) {
+    vector<thread> threads;
+    for (int t = 0; t < nthreads; t++) {
+        threads.emplace_back(work,t,N/nthreads);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+mutex shared_lock;
+Writer *shared;
+
+void locked_work(int t, int lines) {
+    for (int i = 0; i < lines; i++) {
+        lock_guard<mutex> guard(shared_lock);
+        (*shared)("thread")(t)("line")(i)(1.5*i)();
+    }
+}
+
+ConcurrentWriter *cw;
+
+void concurrent_work(int t, int lines) {
+    Writer& w = cw->local();
+    for (int i = 0; i < lines; i++) {
+        w("thread")(t)("line")(i)(1.5*i)();
+    }
+}
+
+// every line must have arrived intact
+bool check(int nthreads) {
+    FILE *in = fopen(file,"r");
+    char line[128], word[16], rest[32];
+    int t, i, n = 0;
+    bool ok = true;
+    while (fgets(line,sizeof(line),in)) {
+        if (sscanf(line,"%15s %d %15s %d %31s",word,&t,word,&i,rest) != 5) {
+            ok = false;
+        }
+        ++n;
+    }
+    fclose(in);
+    return ok && n == nthreads*(N/nthreads);
+}
+
+uint64_t timeit(int nthreads, bool concurrent) {
+    Writer out(file);
+    out.sep(' ');
+    uint64_t start = millisecs();
+    if (concurrent) {
+        cw = new ConcurrentWriter(out);
+        run_threads(nthreads,concurrent_work);
+        cw->flush();
+        delete cw;
+    } else {
+        shared = &out;
+        run_threads(nthreads,locked_work);
+        out.flush();
+    }
+    uint64_t diff = millisecs() - start;
+    out.close();
+    if (! check(nthreads)) {
+        outs("corrupt output with")(nthreads)("threads")();
+    }
+    return diff;
+}
+
+int main(int argc, char **argv)
+{
+    outs("threads")("mutex ms")("concurrent ms")();
+    for (int nthreads = 1; nthreads <= 32; nthreads *= 2) {
+        uint64_t locked = timeit(nthreads,false);
+        uint64_t concurrent = timeit(nthreads,true);
+        outs(nthreads)(locked)(concurrent)();
+    }
+    remove(file);
+    return 0;
+}
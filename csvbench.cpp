@@ -0,0 +1,105 @@
+// CSV rows read field by field: CsvReader against getline with a StrReader
+// over each line, which was the way to do it before
+#include "instream.h"
+#include "outstream.h"
+#include <vector>
+#include <time.h>
+using namespace std;
+using namespace stream;
+
+static uint64_t microsecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return 1000000L*ts.tv_sec + ts.tv_nsec/1000L;
+}
+
+const int N = 1000000;
+const char *plain_file = "c.csv";
+const char *quoted_file = "q.csv";
+
+// the sums make sure that every method read the same values
+double sum;
+
+void make_files() {
+    Writer w(plain_file), q(quoted_file);
+    for (int i = 0; i < N; i++) {
+        w.fmt("%d,%.6f,name%d,%.4f,%d\n",i,i*0.25,i%100,1000.0/(i+1),i*3);
+        q.fmt("%d,%.6f,\"name, \"\"%d\"\"\",%.4f,%d\n",i,i*0.25,i%100,1000.0/(i+1),i*3);
+    }
+}
+
+void read_lines() {
+    Reader rdr(plain_file);
+    string line, s;
+    int64_t i, j;
+    double x, y;
+    while (rdr.getline(line)) {
+        StrReader sr(line);
+        sr.separators(",");
+        if (sr(i)(x)(s)(y)(j)) {
+            sum += i + x + y + j;
+        }
+    }
+}
+
+void read_csv(const char *file) {
+    CsvReader csv(file);
+    string s;
+    int64_t i, j;
+    double x, y;
+    while (csv(i)(x)(s)(y)(j)) {
+        sum += i + x + y + j;
+    }
+}
+
+void read_csv_plain() {
+    read_csv(plain_file);
+}
+
+void read_csv_quoted() {
+    read_csv(quoted_file);
+}
+
+// just splitting: the fields are views into the record buffer
+void read_rows(const char *file) {
+    CsvReader csv(file);
+    vector<string_view> fields;
+    while (csv.row(fields)) {
+        sum += fields.size() + fields[2].size();
+    }
+}
+
+void read_rows_plain() {
+    read_rows(plain_file);
+}
+
+void read_rows_quoted() {
+    read_rows(quoted_file);
+}
+
+uint64_t timeit(const char *name, const char *file, void (*test)()) {
+    sum = 0;
+    uint64_t start = microsecs();
+    test();
+    uint64_t us = microsecs() - start;
+    FILE *f = fopen(file,"r");
+    fseek(f,0,SEEK_END);
+    double mb = (double)ftell(f)/(1024*1024);
+    fclose(f);
+    outs(name)(us/1000,"%5d")("ms")(mb/(us/1e6),"%7.0f")("MB/s")("sum")(sum,"%.17g")();
+    return us;
+}
+
+int main(int argc, char **argv)
+{
+    make_files();
+    uint64_t lines_us = timeit("getline+StrReader",plain_file,read_lines);
+    uint64_t csv_us = timeit("CsvReader        ",plain_file,read_csv_plain);
+    timeit("CsvReader rows   ",plain_file,read_rows_plain);
+    timeit("CsvReader quoted ",quoted_file,read_csv_quoted);
+    timeit("rows quoted      ",quoted_file,read_rows_quoted);
+    outs("speedup vs getline+StrReader")((double)lines_us/(csv_us ? csv_us : 1),"%.2f")("x")();
+    remove(plain_file);
+    remove(quoted_file);
+    return 0;
+}
@@ -0,0 +1,231 @@
+// Lightweight operator() overloading stdio wrapper
+// printf-free number formatting used by Writer's default formats
+// Steve Donovan, (c) 2016
+// MIT license
+#include "fastfmt.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define HAVE_SSE2
+#endif
+
+namespace stream {
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// the powers of ten which are exactly representable as doubles
+static const double pow10_tab[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const int max_exact_pow10 = 22;
+
+// %g has six significant digits
+const int g_precision = 6;
+
+size_t format_u64(char *buf, uint64_t v) {
+    char tmp[24];
+    char *p = tmp + sizeof(tmp);
+    while (v >= 100) {
+        unsigned i = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = digit_pairs[i+1];
+        *--p = digit_pairs[i];
+    }
+    if (v >= 10) {
+        unsigned i = (unsigned)v * 2;
+        *--p = digit_pairs[i+1];
+        *--p = digit_pairs[i];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    size_t n = tmp + sizeof(tmp) - p;
+    memcpy(buf,p,n);
+    return n;
+}
+
+size_t format_i64(char *buf, int64_t v) {
+    if (v < 0) {
+        *buf = '-';
+        return 1 + format_u64(buf+1, 0 - (uint64_t)v);
+    }
+    return format_u64(buf,(uint64_t)v);
+}
+
+size_t format_hex(char *buf, uint64_t v, bool upper, int digits) {
+    const char *hex = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char tmp[16];
+    char *p = tmp + sizeof(tmp);
+    do {
+        *--p = hex[v & 0xF];
+        v >>= 4;
+    } while (v != 0 || tmp + sizeof(tmp) - p < digits);
+    size_t n = tmp + sizeof(tmp) - p;
+    memcpy(buf,p,n);
+    return n;
+}
+
+#ifdef HAVE_SSE2
+// 16 bytes become 32 digits: the nibbles are split out and interleaved, high
+// first, and '0' is added, plus the gap up to 'A' or 'a' for those over 9
+static void hex_digits16(char *out, const unsigned char *p, __m128i gap) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i low4 = _mm_set1_epi8(0x0F);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v,4),low4);
+    __m128i lo = _mm_and_si128(v,low4);
+    __m128i nibbles[2] = {_mm_unpacklo_epi8(hi,lo), _mm_unpackhi_epi8(hi,lo)};
+    for (int k = 0; k < 2; ++k) {
+        __m128i n = nibbles[k];
+        __m128i over9 = _mm_cmpgt_epi8(n,_mm_set1_epi8(9));
+        n = _mm_add_epi8(_mm_add_epi8(n,_mm_set1_epi8('0')),_mm_and_si128(over9,gap));
+        _mm_storeu_si128((__m128i*)(out + 16*k),n);
+    }
+}
+#endif
+
+size_t format_hex_bytes(char *buf, const unsigned char *p, size_t n, bool upper, char sep) {
+    const char *hex = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char *out = buf;
+    size_t i = 0;
+#ifdef HAVE_SSE2
+    __m128i gap = _mm_set1_epi8(upper ? 'A' - '0' - 10 : 'a' - '0' - 10);
+    for (; i + 16 <= n; i += 16) {
+        if (sep == 0) {
+            hex_digits16(out,p + i,gap);
+            out += 32;
+            continue;
+        }
+        char tmp[32];
+        hex_digits16(tmp,p + i,gap);
+        for (int k = 0; k < 16; ++k) {
+            if (i + k > 0) *out++ = sep;
+            *out++ = tmp[2*k];
+            *out++ = tmp[2*k+1];
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (sep != 0 && i > 0) *out++ = sep;
+        *out++ = hex[p[i] >> 4];
+        *out++ = hex[p[i] & 0xF];
+    }
+    return out - buf;
+}
+
+static size_t format_g_slow(char *buf, double x) {
+    return snprintf(buf,num_buf_size,"%g",x);
+}
+
+// x * 10^s with a single rounding, provided |s| <= max_exact_pow10
+static double scale10(double x, int s) {
+    return s >= 0 ? x*pow10_tab[s] : x/pow10_tab[-s];
+}
+
+size_t format_g(char *buf, double x) {
+    if (x != x || x - x != 0) { // nan or inf
+        return format_g_slow(buf,x);
+    }
+    double ax = x < 0 ? -x : x;
+    char *p = buf;
+    if (x < 0 || (x == 0 && 1/x < 0)) {
+        *p++ = '-';
+    }
+    if (ax == 0) {
+        *p++ = '0';
+        return p - buf;
+    }
+
+    // find e so that r = ax*10^(5-e) lies in [1e5,1e6); the estimate
+    // from the binary exponent can be out by one, so check and correct
+    int bexp;
+    frexp(ax,&bexp);
+    int e = (int)floor((bexp - 1)*0.30102999566398120);
+    double r = 0;
+    for (int tries = 0; tries < 3; ++tries) {
+        int s = g_precision - 1 - e;
+        if (s > max_exact_pow10 || s < -max_exact_pow10) {
+            return format_g_slow(buf,x);
+        }
+        r = scale10(ax,s);
+        if (r >= 1e6) {
+            ++e;
+        } else
+        if (r < 1e5) {
+            --e;
+        } else {
+            break;
+        }
+    }
+    if (r < 1e5 || r >= 1e6) {
+        return format_g_slow(buf,x);
+    }
+
+    // r carries at most half an ulp (< 1e-10) of error, so rounding is
+    // only in doubt when we are very close to a tie
+    uint64_t digits = (uint64_t)r;
+    double frac = r - (double)digits;
+    if (fabs(frac - 0.5) < 1e-9) {
+        return format_g_slow(buf,x);
+    }
+    if (frac > 0.5) {
+        ++digits;
+    }
+    if (digits == 1000000) {
+        digits = 100000;
+        ++e;
+    }
+
+    char d[8];
+    format_u64(d,digits);
+    int nd = g_precision;
+    while (nd > 1 && d[nd-1] == '0') {
+        --nd;
+    }
+
+    if (e < -4 || e >= g_precision) {
+        *p++ = d[0];
+        if (nd > 1) {
+            *p++ = '.';
+            memcpy(p,d+1,nd-1);
+            p += nd-1;
+        }
+        *p++ = 'e';
+        *p++ = e < 0 ? '-' : '+';
+        int ae = e < 0 ? -e : e;
+        *p++ = digit_pairs[ae*2];
+        *p++ = digit_pairs[ae*2+1];
+    } else
+    if (e >= 0) {
+        memcpy(p,d,e+1);
+        p += e+1;
+        if (nd > e+1) {
+            *p++ = '.';
+            memcpy(p,d+e+1,nd-e-1);
+            p += nd-e-1;
+        }
+    } else {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = -1; i > e; --i) {
+            *p++ = '0';
+        }
+        memcpy(p,d,nd);
+        p += nd;
+    }
+    return p - buf;
+}
+
+}
+
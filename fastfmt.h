@@ -0,0 +1,40 @@
+// Lightweight operator() overloading stdio wrapper
+// printf-free number formatting used by Writer's default formats
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_FASTFMT_H
+#define __OUTSTREAM_FASTFMT_H
+#include <stddef.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+namespace stream {
+
+/// big enough for any integer or %g output, including sign and NUL
+const size_t num_buf_size = 32;
+
+/// these write into `buf` (at least num_buf_size bytes), add no NUL,
+/// and return the number of characters written.
+
+/// decimal, same as "%" PRIu64
+size_t format_u64(char *buf, uint64_t v);
+
+/// decimal, same as "%" PRIi64
+size_t format_i64(char *buf, int64_t v);
+
+/// hex without prefix, same as "%" PRIX64 or "%" PRIx64; with `digits`
+/// it is zero-padded to at least that many
+size_t format_hex(char *buf, uint64_t v, bool upper, int digits=1);
+
+/// two hex digits for each of `n` bytes, with `sep` between bytes unless it is 0;
+/// `buf` needs room for 3n characters
+size_t format_hex_bytes(char *buf, const unsigned char *p, size_t n, bool upper, char sep);
+
+/// same as "%g"; uses exact scaling where possible and
+/// only falls back on snprintf for ties, huge/tiny exponents and nan/inf
+size_t format_g(char *buf, double x);
+
+}
+
+#endif
@@ -0,0 +1,375 @@
+// Lightweight operator() overloading stdio wrapper
+// scanf-free number parsing used by Reader's default formats
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_FASTSCAN_H
+#define __OUTSTREAM_FASTSCAN_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <string>
+
+namespace stream {
+
+// These consume input exactly as the equivalent scanf conversion would
+// (%lld, %llu, %lf and %f) and return what scanf would return:
+// 1 for a match, 0 for no match and EOF if the input ran out first.
+// A source has get(), which returns EOF at the end, and unget(c) for
+// pushing back the last character; consumed() counts what was taken, like %n.
+
+/// characters from a stdio stream, which the caller should lock
+class FileChars {
+    FILE *f;
+    int n;
+public:
+    /// `n` counts what the caller has already taken
+    FileChars(FILE *f, int n=0) : f(f), n(n) {}
+    int get() {
+        int c = getc_unlocked(f);
+        if (c != EOF) ++n;
+        return c;
+    }
+    void unget(int c) {
+        if (c != EOF) {
+            ungetc(c,f);
+            --n;
+        }
+    }
+    int consumed() const { return n; }
+};
+
+/// characters from a window of memory, which need not be NUL-terminated
+class StrChars {
+    const char *start;
+    const char *P;
+    const char *end;
+public:
+    StrChars(const char *P, const char *end) : start(P), P(P), end(end) {}
+    /// counting from `start`, though we begin at P
+    StrChars(const char *start, const char *P, const char *end) : start(start), P(P), end(end) {}
+    int get() {
+        return P < end ? (unsigned char)*P++ : EOF;
+    }
+    void unget(int c) {
+        if (c != EOF) --P;
+    }
+    int consumed() const { return (int)(P - start); }
+    const char *here() const { return P; }
+};
+
+namespace scan_detail {
+
+inline bool is_space(int c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool is_digit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+inline int lower(int c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+// the text of a number, kept for the strtod fallback; it starts with
+// the character last taken from `in`
+template <class Src>
+class Token {
+    char buf[64];
+    size_t n;
+    std::string big;
+public:
+    Token(Src&) : n(0) {}
+    void push(int c) {
+        if (n < sizeof(buf)-1) {
+            buf[n++] = (char)c;
+        } else {
+            if (big.empty()) big.assign(buf,n);
+            big += (char)c;
+        }
+    }
+    const char *c_str(Src&) {
+        if (! big.empty()) return big.c_str();
+        buf[n] = 0;
+        return buf;
+    }
+};
+
+// text in memory is already there, up to where the source has got to,
+// and is only copied when strtod needs it
+template <>
+class Token<StrChars> {
+    const char *first;
+    std::string text;
+public:
+    Token(StrChars& in) : first(in.here() - 1) {}
+    void push(int c) {}
+    const char *c_str(StrChars& in) {
+        text.assign(first,in.here());
+        return text.c_str();
+    }
+};
+
+// skip whitespace, returning the first other character
+template <class Src>
+int skip_space(Src& in) {
+    int c = in.get();
+    while (is_space(c)) {
+        c = in.get();
+    }
+    return c;
+}
+
+// the magnitude of an optionally signed decimal integer; like strtoull,
+// it saturates on overflow but consumes all the digits
+template <class Src>
+int scan_magnitude(Src& in, uint64_t& mag, bool& neg, bool& overflow) {
+    int c = skip_space(in);
+    if (c == EOF) return EOF;
+    neg = false;
+    overflow = false;
+    if (c == '-' || c == '+') {
+        neg = c == '-';
+        c = in.get();
+    }
+    if (! is_digit(c)) {
+        in.unget(c);
+        return 0;
+    }
+    mag = 0;
+    for (; is_digit(c); c = in.get()) {
+        unsigned d = c - '0';
+        if (mag > (UINT64_MAX - d)/10) {
+            overflow = true;
+        } else {
+            mag = 10*mag + d;
+        }
+    }
+    in.unget(c);
+    if (overflow) mag = UINT64_MAX;
+    return 1;
+}
+
+// the powers of ten which are exactly representable as doubles
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// and as floats
+static const float exact_pow10f[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+// infinity or nan, which strtod converts once we have the letters.
+// glibc's scanf stops after "nan" even when "(n-char-sequence)" follows,
+// so neither word takes a bracket
+template <class Src>
+bool scan_word(Src& in, int c, Token<Src>& tok) {
+    const char *word = lower(c) == 'i' ? "inf" : "nan";
+    for (int i = 0; i < 3; ++i, c = in.get()) {
+        if (lower(c) != word[i]) {
+            in.unget(c);
+            return false;
+        }
+        tok.push(c);
+    }
+    if (word[0] == 'i' && lower(c) == 'i') {
+        // "infinity" has to be complete, once started
+        const char *rest = "inity";
+        for (int i = 0; i < 5; ++i, c = in.get()) {
+            if (lower(c) != rest[i]) {
+                in.unget(c);
+                return false;
+            }
+            tok.push(c);
+        }
+    }
+    in.unget(c);
+    return true;
+}
+
+// hexadecimal floats go to strtod as well; false if there is nothing after 0x.
+// The binary exponent is decimal, and its 'p' and sign are consumed regardless
+template <class Src>
+bool scan_hex(Src& in, Token<Src>& tok) {
+    int c = in.get();
+    bool any = false;
+    bool dot = false;
+    for (; isxdigit(c) || (c == '.' && ! dot); c = in.get()) {
+        any = any || c != '.';
+        dot = dot || c == '.';
+        tok.push(c);
+    }
+    if (any && lower(c) == 'p') {
+        tok.push(c);
+        c = in.get();
+        if (c == '-' || c == '+') {
+            tok.push(c);
+            c = in.get();
+        }
+        for (; is_digit(c); c = in.get()) {
+            tok.push(c);
+        }
+    }
+    in.unget(c);
+    return any || dot; // as glibc has it, "0x." is zero
+}
+
+// A decimal number is converted exactly when its digits fit in 53 bits
+// and the power of ten is exact (Clinger's fast path), since then there
+// is only one rounding. Anything else is converted by strtod from its text.
+template <class Src, class T>
+int scan_real(Src& in, T& val) {
+    const bool single = sizeof(T) < sizeof(double);
+    int c = skip_space(in);
+    if (c == EOF) return EOF;
+    Token<Src> tok(in);
+    bool neg = false;
+    if (c == '-' || c == '+') {
+        neg = c == '-';
+        tok.push(c);
+        c = in.get();
+    }
+    if (lower(c) == 'i' || lower(c) == 'n') {
+        if (! scan_word(in,c,tok)) return 0;
+        val = single ? strtof(tok.c_str(in),nullptr) : strtod(tok.c_str(in),nullptr);
+        return 1;
+    }
+    uint64_t mant = 0;
+    int digits = 0, dropped = 0, exp10 = 0;
+    bool any = false;
+    if (c == '0') {
+        tok.push(c);
+        c = in.get();
+        any = true;
+        if (lower(c) == 'x') {
+            tok.push(c);
+            if (! scan_hex(in,tok)) return 0;
+            char *end;
+            const char *s = tok.c_str(in);
+            double x = single ? strtof(s,&end) : strtod(s,&end);
+            if (end == s) return 0;
+            val = (T)x;
+            return 1;
+        }
+    }
+    for (; is_digit(c); c = in.get()) {
+        tok.push(c);
+        any = true;
+        if (mant == 0 && c == '0') continue;
+        if (digits < 19) {
+            mant = 10*mant + (c - '0');
+            ++digits;
+        } else {
+            ++dropped;
+            ++exp10;
+        }
+    }
+    if (c == '.') {
+        tok.push(c);
+        c = in.get();
+        for (; is_digit(c); c = in.get()) {
+            tok.push(c);
+            any = true;
+            if (mant == 0 && c == '0') {
+                --exp10;
+            } else
+            if (digits < 19) {
+                mant = 10*mant + (c - '0');
+                ++digits;
+                --exp10;
+            } else {
+                ++dropped;
+            }
+        }
+    }
+    if (! any) {
+        in.unget(c);
+        return 0;
+    }
+    if (c == 'e' || c == 'E') {
+        // like scanf, an exponent with no digits is consumed and ignored
+        tok.push(c);
+        c = in.get();
+        bool eneg = false;
+        if (c == '-' || c == '+') {
+            eneg = c == '-';
+            tok.push(c);
+            c = in.get();
+        }
+        int e = 0;
+        for (; is_digit(c); c = in.get()) {
+            tok.push(c);
+            if (e < 100000) e = 10*e + (c - '0');
+        }
+        exp10 += eneg ? -e : e;
+    }
+    in.unget(c);
+
+    if (mant == 0) {
+        val = neg ? -(T)0 : (T)0;
+        return 1;
+    }
+    if (dropped == 0) {
+        if (single) {
+            if (mant <= (1u << 24) && exp10 >= -10 && exp10 <= 10) {
+                float x = (float)mant;
+                x = exp10 < 0 ? x/exact_pow10f[-exp10] : x*exact_pow10f[exp10];
+                val = (T)(neg ? -x : x);
+                return 1;
+            }
+        } else
+        if (mant <= (UINT64_C(1) << 53) && exp10 >= -22 && exp10 <= 22) {
+            double x = (double)mant;
+            x = exp10 < 0 ? x/exact_pow10[-exp10] : x*exact_pow10[exp10];
+            val = (T)(neg ? -x : x);
+            return 1;
+        }
+    }
+    val = single ? strtof(tok.c_str(in),nullptr) : strtod(tok.c_str(in),nullptr);
+    return 1;
+}
+
+} // namespace scan_detail
+
+template <class Src>
+int scan_int64(Src& in, int64_t& val) {
+    uint64_t mag;
+    bool neg, overflow;
+    int res = scan_detail::scan_magnitude(in,mag,neg,overflow);
+    if (res != 1) return res;
+    if (neg) {
+        val = mag > (uint64_t)INT64_MAX + 1 ? INT64_MIN : (int64_t)(0 - mag);
+    } else {
+        val = mag > (uint64_t)INT64_MAX ? INT64_MAX : (int64_t)mag;
+    }
+    return 1;
+}
+
+/// as with strtoull, a minus sign negates modulo 2^64
+template <class Src>
+int scan_uint64(Src& in, uint64_t& val) {
+    uint64_t mag;
+    bool neg, overflow;
+    int res = scan_detail::scan_magnitude(in,mag,neg,overflow);
+    if (res != 1) return res;
+    val = neg && ! overflow ? 0 - mag : mag;
+    return 1;
+}
+
+template <class Src>
+int scan_double(Src& in, double& val) {
+    return scan_detail::scan_real(in,val);
+}
+
+template <class Src>
+int scan_float(Src& in, float& val) {
+    return scan_detail::scan_real(in,val);
+}
+
+}
+
+#endif
@@ -0,0 +1,246 @@
+// Lightweight operator() overloading stdio wrapper
+// Writer over a raw POSIX file descriptor
+// Steve Donovan, (c) 2016
+// MIT license
+#include "fdwriter.h"
+#include <unistd.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <errno.h>
+using namespace std;
+
+namespace stream {
+
+const size_t fd_chunk_size = 65536;
+const size_t fd_batch = 16;
+
+// note Writer(stderr) - so that the writer's FILE* isn't NULL
+FdWriter::FdWriter(int fd, bool own, char sepr)
+    : Writer(stderr,sepr), fd(fd), fd_owner(own), max_chunks(fd_batch), used(0), orig(nullptr)
+{
+    buffering(fd_chunk_size);
+    if (fd < 0) {
+        out = nullptr;
+    }
+}
+
+FdWriter::FdWriter(const char *file, int flags, int mode)
+    : Writer(stderr), fd(::open(file,flags,mode)), fd_owner(true), max_chunks(fd_batch), used(0), orig(nullptr)
+{
+    buffering(fd_chunk_size);
+    if (fd < 0) {
+        out = nullptr;
+    }
+}
+
+FdWriter::FdWriter(const FdWriter& w)
+    : Writer(w), fd(-1), fd_owner(false), max_chunks(w.max_chunks), used(0),
+      orig(w.orig ? w.orig : const_cast<FdWriter*>(&w))
+{
+}
+
+FdWriter::~FdWriter() {
+    close();
+}
+
+void FdWriter::close() {
+    if (orig != nullptr) return;
+    flush_chunks();
+    if (fd_owner && fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    out = nullptr;
+}
+
+FdWriter& FdWriter::batch(size_t n) {
+    if (orig != nullptr) {
+        orig->batch(n);
+        return *this;
+    }
+    max_chunks = n > 0 ? n : 1;
+    return *this;
+}
+
+// the current chunk, if it has room for `needed` more bytes; otherwise the next one
+string& FdWriter::chunk(size_t needed) {
+    if (used == 0 || chunks[used-1].size() + needed > obuf_size) {
+        if (used == max_chunks) {
+            flush_chunks();
+        }
+        if (used == chunks.size()) {
+            chunks.push_back(string());
+            chunks.back().reserve(obuf_size);
+        }
+        ++used;
+    }
+    return chunks[used-1];
+}
+
+size_t FdWriter::pending() {
+    size_t n = 0;
+    for (size_t i = 0; i < used; ++i) {
+        n += chunks[i].size();
+    }
+    return n;
+}
+
+static bool write_all(int fd, struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(fd,iov,cnt > IOV_MAX ? IOV_MAX : cnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+// all pending chunks, followed by `extra` if given, go out in one writev
+void FdWriter::flush_chunks(const char *extra, size_t extra_n) {
+    vector<struct iovec> iov;
+    iov.reserve(used + 1);
+    for (size_t i = 0; i < used; ++i) {
+        if (chunks[i].size() > 0) {
+            struct iovec v = {(void*)chunks[i].data(), chunks[i].size()};
+            iov.push_back(v);
+        }
+    }
+    if (extra_n > 0) {
+        struct iovec v = {(void*)extra, extra_n};
+        iov.push_back(v);
+    }
+    if (iov.size() > 0 && fd >= 0 && ! write_all(fd,&iov[0],iov.size())) {
+        out = nullptr;
+    }
+    for (size_t i = 0; i < used; ++i) {
+        chunks[i].clear();
+    }
+    used = 0;
+}
+
+void FdWriter::write_char(char ch) {
+    if (orig != nullptr) {
+        orig->write_char(ch);
+        return;
+    }
+    if (obuf_size == 0) {
+        flush_chunks(&ch,1);
+    } else {
+        chunk(1) += ch;
+    }
+}
+
+void FdWriter::write_raw(const char *s, size_t n) {
+    if (orig != nullptr) {
+        orig->write_raw(s,n);
+        return;
+    }
+    if (n >= obuf_size) {
+        flush_chunks(s,n);
+    } else {
+        chunk(n).append(s,n);
+    }
+}
+
+void FdWriter::write_out(const char *fmt, va_list ap) {
+    if (orig != nullptr) {
+        orig->write_out(fmt,ap);
+        return;
+    }
+    va_list aq;
+    va_copy(aq,ap);
+    string& c = chunk(1);
+    size_t len = c.size(), avail = obuf_size - len;
+    c.resize(obuf_size);
+    int nch = vsnprintf(&c[len],avail,fmt,ap);
+    if (nch < 0) {
+        c.resize(len);
+    } else
+    if ((size_t)nch < avail) {
+        c.resize(len + nch);
+    } else {
+        c.resize(len);
+        string tmp(nch,'\0');
+        vsnprintf(&tmp[0],nch+1,fmt,aq);
+        write_raw(tmp.data(),nch);
+    }
+    va_end(aq);
+}
+
+void FdWriter::put_eoln() {
+    if (orig != nullptr) {
+        orig->put_eoln();
+        return;
+    }
+    write_char('\n');
+    if (by_line) {
+        flush_chunks();
+    }
+}
+
+Writer& FdWriter::flush() {
+    if (orig != nullptr) {
+        orig->flush();
+        return *this;
+    }
+    flush_chunks();
+    return *this;
+}
+
+int FdWriter::write(const void *buf, int bufsize) {
+    if (orig != nullptr) return orig->write(buf,bufsize);
+    flush_chunks((const char*)buf,bufsize);
+    return out != nullptr;
+}
+
+FILE *FdWriter::stream() {
+    if (orig != nullptr) return orig->stream();
+    flush_chunks();
+    return nullptr;
+}
+
+Writer& FdWriter::buffering(size_t size, bool line) {
+    if (orig != nullptr) {
+        orig->buffering(size,line);
+        return *this;
+    }
+    flush_chunks();
+    return Writer::buffering(size,line);
+}
+
+int FdWriter::handle_fd() {
+    return orig != nullptr ? orig->handle_fd() : fd;
+}
+
+long FdWriter::getpos() {
+    if (orig != nullptr) return orig->getpos();
+    return lseek(fd,0,SEEK_CUR) + pending();
+}
+
+void FdWriter::setpos(long p, char end) {
+    if (orig != nullptr) {
+        orig->setpos(p,end);
+        return;
+    }
+    int whence = SEEK_SET;
+    if (end == '$') {
+        whence = SEEK_END;
+    } else
+    if (end == '.') {
+        whence = SEEK_CUR;
+    }
+    flush_chunks();
+    lseek(fd,p,whence);
+}
+
+}
@@ -0,0 +1,63 @@
+// Lightweight operator() overloading stdio wrapper
+// Writer over a raw POSIX file descriptor
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_FDWRITER_H
+#define __OUTSTREAM_FDWRITER_H
+#include "outstream.h"
+#include <vector>
+#include <fcntl.h>
+
+namespace stream {
+
+/// FdWriter formats into chunks and writes them out with a single `writev`
+/// once `batch` chunks are pending, so there is no stdio buffering underneath.
+/// Large raw writes are passed to `writev` without being copied.
+class FdWriter: public Writer {
+protected:
+    int fd;
+    bool fd_owner;
+    size_t max_chunks;
+    size_t used;
+    std::vector<std::string> chunks; // the first `used` are pending
+    FdWriter *orig;   // a copy passes everything to the writer it was copied from
+
+    std::string& chunk(size_t needed);
+    void flush_chunks(const char *extra=nullptr, size_t extra_n=0);
+    size_t pending();
+    virtual int handle_fd();
+
+public:
+    /// wrap an open descriptor, which is closed afterwards if `own` is true
+    FdWriter(int fd, bool own=false, char sep=0);
+    /// open a file for writing
+    FdWriter(const char *file, int flags=O_WRONLY|O_CREAT|O_TRUNC, int mode=0644);
+    /// a copy writes through the original, which keeps the descriptor
+    FdWriter(const FdWriter& w);
+    virtual ~FdWriter();
+
+    int handle() { return orig != nullptr ? orig->fd : fd; }
+    virtual void close();
+
+    /// how many chunks to collect before writing them out
+    FdWriter& batch(size_t chunks);
+
+    virtual int write(const void *buf, int bufsize);
+    /// there is no stdio stream; pending chunks are written out and null returned
+    virtual FILE *stream();
+    /// pending chunks are written out first
+    virtual Writer& buffering(size_t size, bool line=false);
+
+    virtual void write_char(char ch);
+    virtual void write_out(const char *fmt, va_list ap);
+    virtual void write_raw(const char *s, size_t n);
+    virtual void put_eoln();
+    virtual Writer& flush();
+    virtual long getpos();
+    virtual void setpos(long p, char end='^');
+};
+
+}
+
+#endif
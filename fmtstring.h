@@ -0,0 +1,251 @@
+// Lightweight operator() overloading stdio wrapper
+// format strings parsed and checked at compile time (C++20)
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_FMTSTRING_H
+#define __OUTSTREAM_FMTSTRING_H
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "fastfmt.h"
+
+namespace stream {
+
+/// a string literal usable as a template argument: w.fmt<"%d %s\n">(i,s)
+template <size_t N>
+struct FmtString {
+    char s[N];
+    constexpr FmtString(const char (&str)[N]) {
+        for (size_t i = 0; i < N; ++i) s[i] = str[i];
+    }
+};
+
+namespace fmt_detail {
+
+// one conversion, together with the literal text that precedes it
+struct Field {
+    size_t lit, lit_len;  // offset into Parsed::text
+    size_t spec;          // offset into Parsed::specs
+    char conv;
+    int narrow;           // 1 for h, 2 for hh
+    bool simple;          // no flags, width or precision
+};
+
+template <size_t N>
+struct Parsed {
+    char text[N] = {};      // literal text with %% collapsed
+    char specs[3*N] = {};   // one NUL-terminated printf format per field
+    Field fields[N] = {};
+    size_t nfields = 0;
+    size_t tail = 0, tail_len = 0;
+};
+
+constexpr bool is_flag(char c) {
+    return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0';
+}
+
+constexpr bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+constexpr bool is_length(char c) {
+    return c == 'h' || c == 'l' || c == 'L' || c == 'q' || c == 'j' || c == 'z' || c == 't';
+}
+
+constexpr bool is_int_conv(char c) {
+    return c == 'd' || c == 'i' || c == 'u' || c == 'o' || c == 'x' || c == 'X';
+}
+
+constexpr bool is_float_conv(char c) {
+    return c == 'f' || c == 'F' || c == 'e' || c == 'E' || c == 'g' || c == 'G' || c == 'a' || c == 'A';
+}
+
+// errors are thrown, which makes them compile errors in a consteval context.
+// Length modifiers are dropped, since the argument type is known; integers
+// are always passed to printf as long long.
+template <size_t N>
+consteval Parsed<N> parse(const char (&f)[N]) {
+    Parsed<N> p;
+    size_t nt = 0, ns = 0, lit = 0, i = 0;
+    while (i < N-1) {
+        if (f[i] != '%') {
+            p.text[nt++] = f[i++];
+            continue;
+        }
+        ++i;
+        if (f[i] == '%') {
+            p.text[nt++] = '%';
+            ++i;
+            continue;
+        }
+        Field fld = {lit, nt - lit, ns, 0, 0, true};
+        p.specs[ns++] = '%';
+        while (is_flag(f[i])) {
+            p.specs[ns++] = f[i++];
+            fld.simple = false;
+        }
+        if (f[i] == '*') throw "'*' width is not supported; put the width in the format";
+        while (is_digit(f[i])) {
+            p.specs[ns++] = f[i++];
+            fld.simple = false;
+        }
+        if (f[i] == '.') {
+            p.specs[ns++] = f[i++];
+            fld.simple = false;
+            if (f[i] == '*') throw "'*' precision is not supported; put the precision in the format";
+            while (is_digit(f[i])) {
+                p.specs[ns++] = f[i++];
+            }
+        }
+        while (is_length(f[i])) {
+            if (f[i] == 'h') ++fld.narrow;
+            ++i;
+        }
+        char c = f[i++];
+        if (c == 0) throw "incomplete conversion at end of format";
+        if (c == 'n') throw "%n is not supported";
+        if (! (is_int_conv(c) || is_float_conv(c) || c == 'c' || c == 's' || c == 'p')) {
+            throw "unknown conversion";
+        }
+        if (is_int_conv(c)) {
+            p.specs[ns++] = 'l';
+            p.specs[ns++] = 'l';
+        }
+        p.specs[ns++] = c;
+        p.specs[ns++] = 0;
+        fld.conv = c;
+        p.fields[p.nfields++] = fld;
+        lit = nt;
+    }
+    p.tail = lit;
+    p.tail_len = nt - lit;
+    return p;
+}
+
+template <FmtString F>
+inline constexpr auto parsed = parse(F.s);
+
+template <class T>
+constexpr bool is_string_arg = std::is_convertible_v<const T&, std::string_view>;
+
+inline std::string_view as_view(const char *s) {
+    return s ? std::string_view(s) : std::string_view("(null)");
+}
+
+inline std::string_view as_view(std::string_view s) {
+    return s;
+}
+
+// used for anything that needs flags, width or precision
+template <class W, class... Args>
+void printf_field(W& w, const char *spec, Args... args) {
+    char buf[64];
+    int n = snprintf(buf,sizeof(buf),spec,args...);
+    if (n < 0) return;
+    if ((size_t)n < sizeof(buf)) {
+        w.raw(buf,n);
+    } else {
+        std::string tmp(n,'\0');
+        snprintf(&tmp[0],n+1,spec,args...);
+        w.raw(tmp.data(),n);
+    }
+}
+
+// the conversion applied by a h or hh length modifier,
+// otherwise the usual promotion of a variadic argument
+template <int Narrow, bool Signed, class T>
+auto narrowed(T v) {
+    if constexpr (Narrow == 1) {
+        return Signed ? (long long)(short)v : (long long)(unsigned short)v;
+    } else
+    if constexpr (Narrow >= 2) {
+        return Signed ? (long long)(signed char)v : (long long)(unsigned char)v;
+    } else {
+        return +v;
+    }
+}
+
+template <FmtString F, size_t I, class W, class T>
+void emit_field(W& w, const T& v) {
+    constexpr Field f = parsed<F>.fields[I];
+    constexpr char c = f.conv;
+    const char *spec = parsed<F>.specs + f.spec;
+    char buf[num_buf_size];
+    if constexpr (f.lit_len > 0) {
+        w.raw(parsed<F>.text + f.lit, f.lit_len);
+    }
+    if constexpr (c == 's') {
+        static_assert(is_string_arg<T>, "%s needs a string argument");
+        std::string_view s = as_view(v);
+        if constexpr (f.simple) {
+            w.raw(s.data(),s.size());
+        } else {
+            printf_field(w,spec,std::string(s).c_str());
+        }
+    } else
+    if constexpr (c == 'c') {
+        static_assert(std::is_integral_v<T>, "%c needs an integral argument");
+        char ch = (char)v;
+        if constexpr (f.simple) {
+            w.raw(&ch,1);
+        } else {
+            printf_field(w,spec,(int)ch);
+        }
+    } else
+    if constexpr (c == 'p') {
+        static_assert(std::is_pointer_v<T>, "%p needs a pointer argument");
+        printf_field(w,spec,(const void*)v);
+    } else
+    if constexpr (c == 'd' || c == 'i') {
+        static_assert(std::is_integral_v<T>, "integer conversion needs an integral argument");
+        long long i = (long long)narrowed<f.narrow,true>(v);
+        if constexpr (f.simple) {
+            w.raw(buf,format_i64(buf,i));
+        } else {
+            printf_field(w,spec,i);
+        }
+    } else
+    if constexpr (is_int_conv(c)) {
+        static_assert(std::is_integral_v<T>, "integer conversion needs an integral argument");
+        auto nv = narrowed<f.narrow,false>(v);
+        unsigned long long u = (std::make_unsigned_t<decltype(nv)>)nv;
+        if constexpr (f.simple && c == 'u') {
+            w.raw(buf,format_u64(buf,u));
+        } else
+        if constexpr (f.simple && (c == 'x' || c == 'X')) {
+            w.raw(buf,format_hex(buf,u,c == 'X'));
+        } else {
+            printf_field(w,spec,u);
+        }
+    } else {
+        static_assert(std::is_floating_point_v<T>, "floating-point conversion needs a floating-point argument");
+        if constexpr (f.simple && c == 'g') {
+            w.raw(buf,format_g(buf,(double)v));
+        } else {
+            printf_field(w,spec,(double)v);
+        }
+    }
+}
+
+} // namespace fmt_detail
+
+/// write args according to the compile-time format F; the output is the
+/// same as fprintf would give, but nothing is parsed at run time.
+template <FmtString F, class W, class... Args>
+void emit_format(W& w, const Args&... args) {
+    constexpr auto& p = fmt_detail::parsed<F>;
+    static_assert(p.nfields == sizeof...(Args), "format string and argument count differ");
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (fmt_detail::emit_field<F,I>(w,args), ...);
+    }(std::index_sequence_for<Args...>{});
+    if constexpr (p.tail_len > 0) {
+        w.raw(p.text + p.tail, p.tail_len);
+    }
+}
+
+}
+
+#endif
@@ -3,8 +3,8 @@ DEFINES = -DOLD_STD_CPP
 STD=c++03
 #STD=c++11
 CXXFLAGS = -std=$(STD) -Os $(DEFINES)
-OUTSTREAM = outstream.o
-LDFLAGS = outstream.o
+OUTSTREAM = outstream.o fastfmt.o
+LDFLAGS = outstream.o fastfmt.o
 TARGET = hello
 
 $(TARGET): $(TARGET).o $(OUTSTREAM)
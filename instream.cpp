@@ -1,30 +1,159 @@
 #include "instream.h"
+#include "arena.h"
+#include "fastscan.h"
+#include <algorithm>
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace stream {
 
 const int line_size = 256;
 
+// the default formats for numbers; read_fmt recognizes these (by address)
+// and parses the number itself rather than going through scanf
+static const char double_fmt[] = "%lf%n";
+static const char float_fmt[] = "%f%n";
+static const char int64_fmt[] = "%" SCNd64 "%n";
+static const char uint64_fmt[] = "%" SCNu64 "%n";
+static const char char_fmt[] = "%c%n";
+static const char string_fmt[] = "%s%n";
+
+static bool is_number_fmt(const char *fmt) {
+    return fmt == double_fmt || fmt == float_fmt || fmt == int64_fmt || fmt == uint64_fmt;
+}
+
+// the arguments are the same as scanf would get: the value, then the %n count,
+// which unlike scanf is also set on failure, so that errors are reported at the bad text
+template <class Src>
+static int scan_number(Src& src, const char *fmt, va_list ap) {
+    int res;
+    if (fmt == double_fmt) {
+        res = scan_double(src,*va_arg(ap,double*));
+    } else
+    if (fmt == float_fmt) {
+        res = scan_float(src,*va_arg(ap,float*));
+    } else
+    if (fmt == int64_fmt) {
+        res = scan_int64(src,*va_arg(ap,int64_t*));
+    } else {
+        res = scan_uint64(src,*va_arg(ap,uint64_t*));
+    }
+    *va_arg(ap,int*) = src.consumed();
+    return res;
+}
+
+LineIndex::LineIndex() : starts(1,0), scanned(0) {
+}
+
+void LineIndex::clear() {
+    starts.assign(1,0);
+    scanned = 0;
+}
+
+long LineIndex::line_start(size_t n) const {
+    return n >= 1 && n <= starts.size() ? starts[n-1] : -1;
+}
+
+size_t LineIndex::line_of(long p, long& start) const {
+    size_t line = std::upper_bound(starts.begin(),starts.end(),p) - starts.begin();
+    start = starts[line-1];
+    return line;
+}
+
+void LineIndex::scan(const char *P, size_t n) {
+    const char *E = P + n, *block = P;
+    while ((P = (const char*)memchr(P,'\n',E - P)) != nullptr) {
+        ++P;
+        starts.push_back(scanned + (P - block));
+    }
+    scanned += n;
+}
+
+void LineIndex::line_read(long next, bool newline) {
+    if (newline) {
+        starts.push_back(next);
+    }
+    scanned = next;
+}
+
+// a header, then the line starts as they are in memory
+struct IndexHeader {
+    char magic[8];
+    int64_t size;
+    int64_t mtime;
+    int64_t inode;
+    int64_t scanned;
+    int64_t count;
+    int64_t width;
+};
+
+static const char index_magic[8] = {'o','s','l','i','n','e','s','2'};
+
+bool LineIndex::save(const std::string& file, const FileStamp& stamp) {
+    FILE *out = fopen(file.c_str(),"wb");
+    if (out == nullptr) return false;
+    IndexHeader h;
+    memcpy(h.magic,index_magic,sizeof(h.magic));
+    h.size = stamp.size;
+    h.mtime = stamp.mtime;
+    h.inode = stamp.inode;
+    h.scanned = scanned;
+    h.count = starts.size();
+    h.width = sizeof(long);
+    bool ok = fwrite(&h,sizeof(h),1,out) == 1
+        && fwrite(starts.data(),sizeof(long),starts.size(),out) == starts.size();
+    return fclose(out) == 0 && ok;
+}
+
+bool LineIndex::load(const std::string& file, const FileStamp& stamp) {
+    FILE *in = fopen(file.c_str(),"rb");
+    if (in == nullptr) return false;
+    IndexHeader h;
+    bool ok = fread(&h,sizeof(h),1,in) == 1
+        && memcmp(h.magic,index_magic,sizeof(h.magic)) == 0
+        && h.size == stamp.size && h.mtime == stamp.mtime && h.inode == stamp.inode
+        && h.width == (int64_t)sizeof(long)
+        && h.count > 0;
+    if (ok) {
+        std::vector<long> loaded(h.count);
+        ok = fread(loaded.data(),sizeof(long),loaded.size(),in) == loaded.size();
+        if (ok) {
+            starts.swap(loaded);
+            scanned = h.scanned;
+        }
+    }
+    fclose(in);
+    return ok;
+}
+
 Reader::Reader(FILE *in)
-  : in(in), owner(false),fpos(0),pos(0),bad(0)
+  : in(in), owner(false),fpos(0),pos(0),bad(0),str_arena(nullptr),arena_owner(false),line_buf(nullptr),line_cap(0),track_lines(false),ahead(false)
 {
 }
 
 Reader::Reader(const char *file, const char *how)
-  : in((FILE*)nullptr), owner(true),fpos(0),pos(0)
+  : in((FILE*)nullptr), owner(true),fpos(0),pos(0),str_arena(nullptr),arena_owner(false),line_buf(nullptr),line_cap(0),track_lines(false),ahead(false)
 {
     open(file,how);
 }
 
 Reader::Reader(const std::string& file, const char *how)
-  : in((FILE*)nullptr), owner(true),fpos(0),pos(0)
+  : in((FILE*)nullptr), owner(true),fpos(0),pos(0),str_arena(nullptr),arena_owner(false),line_buf(nullptr),line_cap(0),track_lines(false),ahead(false)
 {
     open(file,how);
 }
 
 Reader::~Reader() {
   close();
+  if (arena_owner) {
+     delete str_arena;
+  }
+  free(line_buf);
 }
 
 void Reader::close() {
@@ -55,14 +184,40 @@ void Reader::set(FILE *new_in, bool own) {
   in = new_in;
   owner = own;
   pos = 0;
+  line_index.clear();
   bad = in == nullptr;
 }
 
+Reader& Reader::use(Arena& a) {
+  if (arena_owner) {
+     delete str_arena;
+  }
+  str_arena = &a;
+  arena_owner = false;
+  return *this;
+}
+
+Arena& Reader::arena() {
+  if (str_arena == nullptr) {
+     str_arena = new Arena();
+     arena_owner = true;
+  }
+  return *str_arena;
+}
+
+// files we open get a bigger buffer than stdio's default, so that
+// lines are mostly found with one memchr over the buffer
+const size_t file_buffer_size = 64*1024;
+
 bool Reader::open(const std::string& file, const char *how) {
     in = fopen(file.c_str(),how);
-    bad = errno;
+    pos = 0;
+    line_index.clear();
+    bad = in == nullptr ? errno : 0;
     if (bad) {
         err_msg = strerror(errno);
+    } else {
+        setvbuf(in,nullptr,_IOFBF,file_buffer_size);
     }
     return ! bad;
 }
@@ -71,7 +226,55 @@ void Reader::close_handle() {
     fclose(in);
 }
 
+#ifdef __GLIBC__
+// The unread part of stdio's buffer, which is refilled if it's empty; false at
+// the end. The tokenizer runs over it in place, and the stream is moved on by
+// advancing its read pointer. The caller holds the lock.
+static bool file_window(FILE *f, const char*& P, const char*& E) {
+    if (f->_IO_read_ptr == f->_IO_read_end) {
+        if (getc_unlocked(f) == EOF) return false;
+        --f->_IO_read_ptr;
+    }
+    P = f->_IO_read_ptr;
+    E = f->_IO_read_end;
+    return true;
+}
+
+// skip delimiters, or take a word into `word` if it isn't null; returns how many bytes were used
+static size_t file_span(FILE *f, const Delims& d, std::string *word) {
+    size_t n = 0;
+    const char *P, *E;
+    while (file_window(f,P,E)) {
+        const char *Q = word ? find_delim(P,E,d) : skip_delims(P,E,d);
+        if (word) word->append(P,Q - P);
+        n += Q - P;
+        f->_IO_read_ptr = (char*)Q;
+        if (Q < E) break;
+    }
+    return n;
+}
+#else
+static size_t file_span(FILE *f, const Delims& d, std::string *word) {
+    FileChars src(f);
+    int c = src.get();
+    while (c != EOF && d[c] == (word == nullptr)) {
+        if (word) *word += (char)c;
+        c = src.get();
+    }
+    src.unget(c);
+    return src.consumed();
+}
+#endif
+
 int Reader::read_fmt(const char *fmt, va_list ap) {
+    if (is_number_fmt(fmt)) {
+        flockfile(in);
+        size_t skipped = delims.extra_count() > 0 ? file_span(in,delims,nullptr) : 0;
+        FileChars src(in,skipped);
+        int res = scan_number(src,fmt,ap);
+        funlockfile(in);
+        return res;
+    }
     return vfscanf(in,fmt,ap);
 }
 
@@ -85,6 +288,48 @@ size_t Reader::read(void *buff, int buffsize) {
     return sz;
 }
 
+// a block at a time, since read() takes an int; the records are converted as
+// each block comes in, while it is still in the cache
+size_t Reader::read_bytes(void *p, size_t n, size_t width, bool swap, bool to_end) {
+    if (fail()) return 0;
+    char *P = (char*)p;
+    size_t bytes = n*width, got = 0;
+    size_t block = width < record_block ? record_block - record_block % width : width;
+    while (got < bytes) {
+        size_t len = bytes - got < block ? bytes - got : block;
+        if (ahead && in != nullptr) {
+            posix_fadvise(fileno(in),ftell(in) + len,block,POSIX_FADV_WILLNEED);
+        }
+        size_t sz = read(P + got,len);
+        if (swap) {
+            swap_bytes(P + got,sz/width,width);
+        }
+        got += sz;
+        if (sz < len) break;
+    }
+    if (got < bytes && ! to_end) {
+        set_error("expected " + std::to_string(n) + " records, got " + std::to_string(got/width),EOF);
+    } else if (got % width != 0) {
+        set_error("last record cut short, " + std::to_string(got % width) + " of " + std::to_string(width) + " bytes",EOF);
+    }
+    return got/width;
+}
+
+long Reader::bytes_left() {
+    FileStamp st;
+    long p = getpos();
+    if (! index_stamp(st) || p == -1) return -1;
+    return st.size > p ? st.size - p : 0;
+}
+
+Reader& Reader::readahead(bool on) {
+    ahead = on;
+    if (in != nullptr) {
+        posix_fadvise(fileno(in),0,0,on ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_NORMAL);
+    }
+    return *this;
+}
+
 void Reader::set_error(const std::string& msg, int code) {
     err_msg = msg;
     bad = code;
@@ -97,7 +342,13 @@ Reader& Reader::formatted_read(const char *ctype, const char *def, const char *f
     if (fmt == nullptr) {
          fmt = def;
     }
+    fpos = 0;
     int res = read_fmt(fmt,ap);
+    va_end(ap);
+    return check_read(ctype,res);
+}
+
+Reader& Reader::check_read(const char *ctype, int res) {
     if (res == EOF) {
         if (errno != 0) { // we remain in hope
             set_error(strerror(errno),errno);
@@ -106,15 +357,70 @@ Reader& Reader::formatted_read(const char *ctype, const char *def, const char *f
         }
     } else
     if (res != 1 && *ctype != 'S') {
+         // the error is at the start of the text that didn't match
+         long at = pos + fpos;
          std::string chars;
          (*this)(chars,"%5s");
          set_error("error reading " + std::string(ctype) + " at '" + chars + "'",1);
+         pos = at;
+         fpos = 0;
     }
     pos += fpos;
-    va_end(ap);
     return *this;
 }
 
+bool Reader::has_views() {
+    return false;
+}
+
+// stdio has no way to look at its buffer, so words from a file are
+// classified a byte at a time
+int Reader::read_word(const char*& word, size_t& len) {
+    fpos = 0;
+    flockfile(in);
+    size_t n = file_span(in,delims,nullptr);
+    word_buf.clear();
+    n += file_span(in,delims,&word_buf);
+    funlockfile(in);
+    if (word_buf.empty()) {
+        if (! ferror(in)) errno = 0;
+        return EOF;
+    }
+    word = word_buf.data();
+    len = word_buf.size();
+    fpos = n;
+    return 1;
+}
+
+Reader& Reader::separators(const char *extra) {
+    delims = Delims(extra);
+    return *this;
+}
+
+// getline(3) finds the newline with memchr in stdio's buffer and copies
+// each stretch once into our buffer, which is kept for the next line
+bool Reader::read_line_view(const char*& line, size_t& len) {
+    ssize_t n = ::getline(&line_buf,&line_cap,in);
+    if (n == -1) {
+        if (ferror(in)) {
+            set_error(strerror(errno),errno);
+        } else {
+            set_error("EOF",EOF);
+        }
+        return false;
+    }
+    long start = pos;
+    pos += n;
+    bool newline = n > 0 && line_buf[n-1] == '\n';
+    line_read(start,newline);
+    if (newline) {
+        --n;
+    }
+    line = line_buf;
+    len = n;
+    return true;
+}
+
 Reader& Reader::conversion_error(const char *kind, uint64_t val, bool was_unsigned) {
    bad = ERANGE;
    std::string msg = "error converting " + std::string(kind) + " out of range ";
@@ -140,6 +446,7 @@ long Reader::getpos() {
      whence = SEEK_CUR;
   }
   fseek(in,p,whence);
+  pos = ftell(in);
 }
 
 int Reader::read_line(char *buff, int buffsize) {
@@ -176,26 +483,26 @@ Reader& Reader::operator() (Reader::Error& err) {
 }
 
 Reader& Reader::operator() (double &i,const char *fmt) {
-  return formatted_read("double","%lf%n",fmt,&i,&fpos);
+  return formatted_read("double",double_fmt,fmt,&i,&fpos);
 }
 
 Reader& Reader::operator() (float &i,const char *fmt) {
-  return formatted_read("float","%f%n",fmt,&i,&fpos);
+  return formatted_read("float",float_fmt,fmt,&i,&fpos);
 }
 
 Reader& Reader::operator() (int64_t &i,const char *fmt) {
-  return formatted_read("int64","%" SCNd64 "%n",fmt,&i,&fpos);
+  return formatted_read("int64",int64_fmt,fmt,&i,&fpos);
 }
 
 Reader& Reader::operator() (uint64_t &i,const char *fmt) {
-  return formatted_read("uint64","%" SCNu64 "%n",fmt,&i,&fpos);
+  return formatted_read("uint64",uint64_fmt,fmt,&i,&fpos);
 }
 
 Reader& Reader::operator() (int32_t &i,const char *fmt) {
    int64_t val;
    if (! (*this)(val)) return *this;
    if (val < INT32_MIN || val > INT32_MAX) return conversion_error("int32",val,false);
-   i = (int16_t)val;
+   i = (int32_t)val;
    return *this;
 }
 
@@ -224,7 +531,7 @@ Reader& Reader::operator() (uint16_t &i,const char *fmt) {
 }
 
 Reader& Reader::operator() (char &i,const char *fmt) {
-  return formatted_read("char","%c%n",fmt,&i,&fpos);
+  return formatted_read("char",char_fmt,fmt,&i,&fpos);
 }
 
 Reader& Reader::operator() (uint8_t &i,const char *fmt) {
@@ -237,12 +544,41 @@ Reader& Reader::operator() (uint8_t &i,const char *fmt) {
 
 Reader& Reader::operator() (std::string &s,const char *fmt) {
   if (fail()) return *this;
+  if (fmt == nullptr) {
+     const char *word;
+     size_t len;
+     if (check_read("string",read_word(word,len))) {
+        s.assign(word,len);
+     }
+     return *this;
+  }
   char buff[line_size];
-  if (! formatted_read("string","%s%n",fmt,buff,&fpos)) return *this;
+  if (! formatted_read("string",string_fmt,fmt,buff,&fpos)) return *this;
   s = buff;
   return *this;
 }
 
+#if __cplusplus >= 201703L
+Reader& Reader::operator() (std::string_view &s,const char *fmt) {
+  if (fail()) return *this;
+  if (fmt == nullptr) {
+     const char *word;
+     size_t len;
+     if (check_read("string",read_word(word,len))) {
+        s = std::string_view(word,len);
+        if (! has_views()) {
+           s = arena().keep(s);
+        }
+     }
+     return *this;
+  }
+  char buff[line_size];
+  if (! formatted_read("string",string_fmt,fmt,buff,&fpos)) return *this;
+  s = arena().keep(buff);
+  return *this;
+}
+#endif
+
 Reader& Reader::operator() (const char *extra) {
   char buff[line_size];
   strcpy(buff,extra);
@@ -256,29 +592,37 @@ Reader& Reader::operator() () {
 
 Reader& Reader::getline(std::string& s) {
   if (fail()) return *this;
-  char buff[line_size];
-  s.clear();
-  int n = read_line(buff,line_size);
-  while (n > 1) {
-    if (buff[n-1]=='\n') {
-       --n;
-       buff[n] = 0; // trim \n
-       s.append(buff,n);
-       break;
-    } else {
-       s.append(buff,n);
-    }
-    n = read_line(buff,line_size);
+  const char *line;
+  size_t len;
+  if (read_line_view(line,len)) {
+     s.assign(line,len);
+  } else {
+     s.clear();
+  }
+  return *this;
+}
+
+#if __cplusplus >= 201703L
+Reader& Reader::getline(std::string_view& s) {
+  if (fail()) return *this;
+  const char *line;
+  size_t len;
+  s = std::string_view();
+  if (read_line_view(line,len)) {
+     s = std::string_view(line,len);
+     if (! has_views()) {
+        s = arena().keep(s);
+     }
   }
   return *this;
 }
+#endif
 
 Reader& Reader::skip(int lines) {
   if (fail()) return *this;
-  int i = 0;
-  char buff[line_size];
-  while (i < lines && read_line(buff,line_size) > 0) {
-     ++i;
+  const char *line;
+  size_t len;
+  for (int i = 0; i < lines && read_line_view(line,len); ++i) {
   }
   return *this;
 }
@@ -286,19 +630,89 @@ Reader& Reader::skip(int lines) {
 Reader::LineInfo Reader::getlineinfo (long p) {
     if (p == -1)
         p = pos;
-    setpos(0,'^');
-    pos = 0;
-    char buff[line_size];
-    int last_pos, lineno = 1;
-    read_line(buff,line_size);
-    while (pos < p) {
-        lineno++;
-        last_pos = pos;
-        read_line(buff,line_size);
+    index_to(p,0);
+    long start;
+    size_t line = line_index.line_of(p,start);
+    return {(int)line, (int)(p - start)};
+}
+
+// lines read in order from the end of the index extend it for nothing
+void Reader::line_read(long start, bool newline) {
+    if (track_lines && start == line_index.end()) {
+        line_index.line_read(pos,newline);
+    }
+}
+
+const size_t index_block_size = 64*1024;
+
+// the index is extended a block at a time, until it gets to p and has at least `line` lines
+void Reader::index_to(long p, size_t line) {
+    std::string scratch;
+    while (line_index.end() < p || line_index.lines() < line) {
+        size_t n = index_block_size;
+        const char *block = index_block(line_index.end(),scratch,n);
+        if (block == nullptr || n == 0) break;
+        line_index.scan(block,n);
     }
-    int col = p - last_pos;
-    setpos(p,'^');
-    return {lineno, col};
+}
+
+// pread leaves stdio's position (and buffer) alone
+const char *Reader::index_block(long off, std::string& scratch, size_t& n) {
+    int fd = in != nullptr ? fileno(in) : -1;
+    if (fd == -1) return nullptr;
+    scratch.resize(n);
+    ssize_t got = pread(fd,&scratch[0],n,off);
+    if (got <= 0) return nullptr;
+    n = got;
+    return scratch.data();
+}
+
+// a file rewritten within the same second has another mtime in nanoseconds,
+// and one replaced by rename has another inode
+static FileStamp stamp_of(const struct stat& st) {
+    FileStamp stamp = {(int64_t)st.st_size, (int64_t)st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec, (int64_t)st.st_ino};
+    return stamp;
+}
+
+bool Reader::index_stamp(FileStamp& stamp) {
+    struct stat st;
+    if (in == nullptr || fstat(fileno(in),&st) == -1 || ! S_ISREG(st.st_mode)) return false;
+    stamp = stamp_of(st);
+    return true;
+}
+
+Reader& Reader::seek_line(size_t n) {
+    index_to(0,n);
+    long start = line_index.line_start(n);
+    if (start == -1) {
+        set_error("no line " + std::to_string(n),EOF);
+        return *this;
+    }
+    // a fresh start, so having got to the end doesn't count
+    if (bad == EOF) {
+        set_error("",0);
+    }
+    setpos(start,'^');
+    pos = start;
+    return *this;
+}
+
+Reader& Reader::index_lines(bool on) {
+    track_lines = on;
+    return *this;
+}
+
+// without a file's modification time, a side file can't be told from a stale one
+bool Reader::save_index(const std::string& file) {
+    FileStamp st;
+    if (! index_stamp(st) || st.mtime == 0) return false;
+    index_to(LONG_MAX,0);
+    return line_index.save(file,st);
+}
+
+bool Reader::load_index(const std::string& file) {
+    FileStamp st;
+    return index_stamp(st) && st.mtime != 0 && line_index.load(file,st);
 }
 
 Reader ins(stdin);
@@ -320,33 +734,107 @@ std::string CmdReader::line() {
 }
 
 
-StrReader::StrReader(const std::string& s) : Reader((FILE*)nullptr), pc(s.c_str()) {
-    size = s.size();
+StrReader::StrReader(const std::string& s) : Reader((FILE*)nullptr), pc(s.data()), size(s.size()) {
+}
+
+// a temporary is moved in, so the reader can't outlive its text
+StrReader::StrReader(std::string&& s) : Reader((FILE*)nullptr), own(std::move(s)) {
+    pc = own.data();
+    size = own.size();
+}
+
+StrReader::StrReader(const char* pc) : Reader((FILE*)nullptr), pc(pc), size(strlen(pc)) {
+}
+
+StrReader::StrReader(const char* pc, size_t size) : Reader((FILE*)nullptr), pc(pc), size(size) {
 }
 
-StrReader::StrReader(const char* pc) : Reader((FILE*)nullptr), pc(pc) {
-    size = strlen(pc);
+#if __cplusplus >= 201703L
+StrReader::StrReader(std::string_view s) : Reader((FILE*)nullptr), pc(s.data()), size(s.size()) {
+}
+#endif
+
+bool StrReader::has_views() {
+    return true;
 }
 
 int StrReader::read_fmt(const char *fmt, va_list ap) {
-    if (pos >= size) {
+    if ((size_t)pos >= size) {
         bad = 1; return 0;
     }
-    return vsscanf(pc+pos,fmt,ap);
+    return scan_fmt(fmt,ap);
+}
+
+// numbers, words and characters are read straight from the text; any other
+// format gets a NUL-terminated copy of the next stretch of it, since the text
+// needn't be terminated and vsscanf would take the length of all the rest
+const size_t scan_window = 4096;
+
+int StrReader::scan_fmt(const char *fmt, va_list ap) {
+    if (is_number_fmt(fmt)) {
+        StrChars src(pc+pos,skip_delims(pc+pos,pc+size,delims),pc+size);
+        return scan_number(src,fmt,ap);
+    }
+    if (fmt == char_fmt) {
+        *va_arg(ap,char*) = pc[pos];
+        *va_arg(ap,int*) = 1;
+        return 1;
+    }
+    if (fmt == string_fmt) {
+        const char *word;
+        size_t len;
+        int res = read_word(word,len);
+        if (res == 1) {
+            len = len < (size_t)line_size - 1 ? len : line_size - 1;
+            char *buff = va_arg(ap,char*);
+            memcpy(buff,word,len);
+            buff[len] = 0;
+            *va_arg(ap,int*) = fpos;
+        }
+        return res;
+    }
+    size_t n = size - pos < scan_window ? size - pos : scan_window;
+    std::string window(pc + pos, n);
+    return vsscanf(window.c_str(),fmt,ap);
 }
 
- char *StrReader::read_raw_line(char *buff, int buffsize) {
-    char *P = buff;
-    const char *Q = pc+pos;
-    int i = 1;
-    while (*Q != '\n' && i < buffsize && *Q != 0) {
-        *P++ = *Q++;
-        ++i;
+// like fgets, the line keeps its '\n'
+char *StrReader::read_raw_line(char *buff, int buffsize) {
+    if ((size_t)pos >= size || buffsize < 1) {
+        return nullptr;
     }
-    *P = 0;
+    size_t n = size - pos < (size_t)buffsize - 1 ? size - pos : buffsize - 1;
+    const char *nl = (const char*)memchr(pc+pos,'\n',n);
+    if (nl != nullptr) {
+        n = nl - (pc+pos) + 1;
+    }
+    memcpy(buff,pc+pos,n);
+    buff[n] = 0;
     return buff;
 }
 
+size_t StrReader::read(void *buff, int buffsize) {
+    if (fail() || (size_t)pos >= size) return 0;
+    size_t n = size - pos < (size_t)buffsize ? size - pos : buffsize;
+    memcpy(buff,pc+pos,n);
+    pos += n;
+    return n;
+}
+
+// the index scans the string where it is
+const char *StrReader::index_block(long off, std::string& scratch, size_t& n) {
+    if ((size_t)off >= size) return nullptr;
+    n = size - off < n ? size - off : n;
+    return pc + off;
+}
+
+bool StrReader::index_stamp(FileStamp& stamp) {
+    stamp.size = size;
+    stamp.mtime = 0;
+    stamp.inode = 0;
+    return true;
+}
+
 long StrReader::getpos() {
     return pos;
 }
@@ -363,6 +851,465 @@ void StrReader::setpos(long p, char end) {
     }
 }
 
+MmapReader::MmapReader(const char *file) : StrReader("",0), map(nullptr), map_size(0), map_stamp() {
+    map_file(file);
+}
+
+MmapReader::MmapReader(const std::string& file) : StrReader("",0), map(nullptr), map_size(0), map_stamp() {
+    map_file(file.c_str());
+}
+
+MmapReader::MmapReader(MmapReader& whole, size_t start, size_t end)
+  : StrReader(whole.pc,end < whole.size ? end : whole.size), map(nullptr), map_size(0), map_stamp(whole.map_stamp) {
+    pos = start;
+}
+
+MmapReader::~MmapReader() {
+    if (map != nullptr) {
+        munmap(map,map_size);
+    }
+}
+
+void MmapReader::map_file(const char *file) {
+    int fd = ::open(file,O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd,&st) == -1) {
+        set_error(strerror(errno),errno);
+        if (fd != -1) ::close(fd);
+        return;
+    }
+    map_size = st.st_size;
+    map_stamp = stamp_of(st);
+    if (map_size > 0) {
+        map = mmap(nullptr,map_size,PROT_READ,MAP_PRIVATE,fd,0);
+        if (map == MAP_FAILED) {
+            map = nullptr;
+            set_error(strerror(errno),errno);
+        } else {
+            madvise(map,map_size,MADV_SEQUENTIAL);
+            pc = (const char*)map;
+            size = map_size;
+        }
+    }
+    ::close(fd);
+}
+
+bool MmapReader::index_stamp(FileStamp& stamp) {
+    stamp = map_stamp;
+    stamp.size = map_size;
+    return map_stamp.mtime != 0;
+}
+
+int MmapReader::read_word(const char*& word, size_t& len) {
+    return next_word(word,len);
+}
+
+// the pages are read in ahead of time, and sooner, for any kind of read
+Reader& MmapReader::readahead(bool on) {
+    if (map != nullptr) {
+        madvise(map,map_size,on ? MADV_SEQUENTIAL : MADV_NORMAL);
+    }
+    return *this;
+}
+
+// the tokenizer classifies a block of bytes at a time
+int StrReader::next_word(const char*& word, size_t& len) {
+    const char *start = pc + pos, *end = pc + size;
+    fpos = 0;
+    const char *P = skip_delims(start,end,delims);
+    if (P == end) {
+        errno = 0;
+        return EOF;
+    }
+    word = P;
+    P = find_delim(P,end,delims);
+    len = P - word;
+    fpos = P - start;
+    return 1;
+}
+
+int StrReader::read_word(const char*& word, size_t& len) {
+    if ((size_t)pos >= size) {
+        bad = 1; return 0;
+    }
+    return next_word(word,len);
+}
+
+bool StrReader::read_line_view(const char*& line, size_t& len) {
+    if ((size_t)pos >= size) {
+        set_error("EOF",EOF);
+        return false;
+    }
+    long start = pos;
+    line = pc + pos;
+    const char *nl = (const char*)memchr(line,'\n',size - pos);
+    len = nl ? nl - line : size - pos;
+    pos += len + (nl ? 1 : 0);
+    line_read(start,nl != nullptr);
+    return true;
+}
+
+int MmapReader::read_fmt(const char *fmt, va_list ap) {
+    if ((size_t)pos >= size) {
+        errno = 0;
+        return EOF;
+    }
+    return scan_fmt(fmt,ap);
+}
+
+// records are found and split in a buffer of this size, which grows to hold a longer record
+const size_t csv_block = 256*1024;
+
+// find_record stops at quotes, newlines and delimiters
+static Delims csv_stops(char delim) {
+    char stops[] = {'"','\n',delim,0};
+    return Delims(stops,false);
+}
+
+CsvReader::CsvReader(const char *file, char delim)
+  : Reader(file), delim(delim), record_stops(csv_stops(delim)) {
+    init();
+}
+
+CsvReader::CsvReader(const std::string& file, char delim)
+  : Reader(file), delim(delim), record_stops(csv_stops(delim)) {
+    init();
+}
+
+CsvReader::CsvReader(FILE *in, char delim)
+  : Reader(in), delim(delim), record_stops(csv_stops(delim)) {
+    init();
+}
+
+void CsvReader::init() {
+    buf.resize(csv_block);
+    start = end = 0;
+    buf_pos = 0;
+    at_eof = false;
+    in_record = false;
+    rec_start = rec_len = 0;
+    rec_off = 0;
+    col = 0;
+}
+
+// the unread bytes move to the front of the buffer, and more are read after them
+bool CsvReader::fill() {
+    if (at_eof || in == nullptr) return false;
+    if (start > 0) {
+        memmove(&buf[0],buf.data() + start,end - start);
+        buf_pos += start;
+        end -= start;
+        start = 0;
+    }
+    if (end == buf.size()) {
+        buf.resize(2*buf.size());
+    }
+    size_t n = fread(&buf[end],1,buf.size() - end,in);
+    end += n;
+    if (n == 0) {
+        at_eof = true;
+        if (ferror(in)) {
+            set_error(strerror(errno),errno);
+        }
+        return false;
+    }
+    return true;
+}
+
+// The record starting at `start` ends at the first newline outside quotes.
+// Quotes follow split_record's rules: only a quote that starts a field opens
+// it, "" inside is a quote, and after the closing quote the rest of the field
+// is plain text, as is a stray quote in an unquoted field.
+// A trailing '\r' isn't part of the record.
+bool CsvReader::find_record(size_t& rec_end, size_t& next) {
+    enum { field_start, plain, quoted, closed } state = field_start;
+    size_t scan = start;
+    size_t after = start;   // just past the last stop seen
+    for (;;) {
+        const char *P = buf.data() + scan, *E = buf.data() + end;
+        while ((P = find_delim(P,E,record_stops)) < E) {
+            size_t at = P - buf.data();
+            if (at > after && state != quoted) {
+                state = plain;
+            }
+            after = at + 1;
+            if (state == quoted) {
+                if (*P == '"') state = closed;
+            } else if (*P == '\n') {
+                rec_end = at;
+                next = rec_end + 1;
+                if (rec_end > start && buf[rec_end-1] == '\r') {
+                    --rec_end;
+                }
+                return true;
+            } else if (*P == delim) {
+                state = field_start;
+            } else if (state == field_start || state == closed) {
+                // a closing quote followed by another is an escaped quote
+                state = quoted;
+            }
+            ++P;
+        }
+        scan = end - start;
+        after -= start;
+        if (! fill()) {
+            if (start == end) return false;
+            rec_end = next = end;
+            if (buf[rec_end-1] == '\r') {
+                --rec_end;
+            }
+            return true;
+        }
+        scan += start;
+        after += start;
+    }
+}
+
+// Quoted fields are unescaped into `unquoted`, so that the record stays as it
+// was read for getline; each field's position is where it starts in the record.
+void CsvReader::split_record() {
+    spans.clear();
+    unquoted.clear();
+    unquoted_at.clear();
+    col = 0;
+    if (rec_len == 0) return;
+    const char *base = &buf[rec_start], *P = base, *E = base + rec_len;
+    for (;;) {
+        FieldPos f = {(size_t)(P - base), 0};
+        const char *R;
+        if (*P == '"') {
+            size_t at = unquoted.size();
+            const char *Q = P + 1;
+            for (;;) {
+                const char *q = (const char*)memchr(Q,'"',E - Q);
+                unquoted.append(Q,(q ? q : E) - Q);
+                if (q == nullptr) {
+                    Q = E;
+                    break;
+                }
+                if (q + 1 < E && q[1] == '"') {
+                    unquoted += '"';
+                    Q = q + 2;
+                } else {
+                    Q = q + 1;
+                    break;
+                }
+            }
+            // anything between the closing quote and the delimiter is kept
+            R = (const char*)memchr(Q,delim,E - Q);
+            if (R == nullptr) R = E;
+            unquoted.append(Q,R - Q);
+            f.len = unquoted.size() - at;
+            unquoted_at.push_back(at);
+        } else {
+            R = (const char*)memchr(P,delim,E - P);
+            if (R == nullptr) R = E;
+            f.len = R - P;
+            unquoted_at.push_back(-1);
+        }
+        spans.push_back(f);
+        if (R == E) break;
+        P = R + 1;
+        if (P == E) {
+            FieldPos last = {(size_t)(P - base), 0};
+            spans.push_back(last);
+            unquoted_at.push_back(-1);
+            break;
+        }
+    }
+}
+
+const char *CsvReader::field_text(size_t i) {
+    return unquoted_at[i] >= 0 ? unquoted.data() + unquoted_at[i] : buf.data() + rec_start + spans[i].start;
+}
+
+bool CsvReader::next_record() {
+    in_record = false;
+    do {
+        size_t rec_end, next;
+        if (! find_record(rec_end,next)) return false;
+        rec_start = start;
+        rec_len = rec_end - start;
+        rec_off = buf_pos + start;
+        start = next;
+        split_record();
+    } while (spans.empty());
+    in_record = true;
+    pos = rec_off;
+    return true;
+}
+
+int CsvReader::next_field(const char*& field, size_t& len) {
+    fpos = 0;
+    while (! in_record || col == spans.size()) {
+        if (! next_record()) {
+            if (! fail()) errno = 0;
+            return EOF;
+        }
+    }
+    field = field_text(col);
+    len = spans[col].len;
+    return 1;
+}
+
+// positions are those of the next field, or the next record
+void CsvReader::field_done() {
+    ++col;
+    pos = col < spans.size() ? rec_off + spans[col].start : buf_pos + start;
+    fpos = 0;
+}
+
+int CsvReader::read_word(const char*& word, size_t& len) {
+    int res = next_field(word,len);
+    if (res == 1) {
+        field_done();
+    }
+    return res;
+}
+
+// a number has to be the whole field, apart from spaces; if it isn't, the
+// field is left for the error message
+int CsvReader::read_fmt(const char *fmt, va_list ap) {
+    const char *field;
+    size_t len;
+    int res = next_field(field,len);
+    if (res != 1) return res;
+    const char *end = field + len;
+    if (is_number_fmt(fmt)) {
+        StrChars src(field,end);
+        res = scan_number(src,fmt,ap);
+        if (res == 1) {
+            const char *P = field + src.consumed();
+            while (P < end && scan_detail::is_space((unsigned char)*P)) ++P;
+            if (P != end) res = 0;
+        }
+        if (res != 1) {
+            fpos = 0;
+            return 0;
+        }
+    } else
+    if (fmt == char_fmt) {
+        if (len == 0) return 0;
+        *va_arg(ap,char*) = *field;
+    } else
+    if (fmt == string_fmt) {
+        len = len < (size_t)line_size - 1 ? len : line_size - 1;
+        char *buff = va_arg(ap,char*);
+        memcpy(buff,field,len);
+        buff[len] = 0;
+    } else {
+        word_buf.assign(field,len);
+        res = vsscanf(word_buf.c_str(),fmt,ap);
+        if (res == EOF) res = 0;
+    }
+    field_done();
+    return res;
+}
+
+// getline hands out records as they are in the file, ending the current one if it was started
+bool CsvReader::read_line_view(const char*& line, size_t& len) {
+    if (in_record) {
+        in_record = false;
+        line = buf.data() + rec_start;
+        len = rec_len;
+        pos = buf_pos + start;
+        return true;
+    }
+    size_t rec_end, next;
+    if (! find_record(rec_end,next)) {
+        if (! fail()) set_error("EOF",EOF);
+        return false;
+    }
+    line = buf.data() + start;
+    len = rec_end - start;
+    start = next;
+    pos = buf_pos + start;
+    return true;
 }
 
+CsvReader& CsvReader::row(std::vector<std::string>& values) {
+    if (fail()) return *this;
+    const char *field;
+    size_t len;
+    if (next_field(field,len) != 1) {
+        set_error("EOF",EOF);
+        return *this;
+    }
+    values.resize(spans.size() - col);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i].assign(field_text(col),spans[col].len);
+        field_done();
+    }
+    return *this;
+}
 
+#if __cplusplus >= 201703L
+CsvReader& CsvReader::row(std::vector<std::string_view>& values) {
+    if (fail()) return *this;
+    const char *field;
+    size_t len;
+    if (next_field(field,len) != 1) {
+        set_error("EOF",EOF);
+        return *this;
+    }
+    values.resize(spans.size() - col);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = std::string_view(field_text(col),spans[col].len);
+        field_done();
+    }
+    return *this;
+}
+#endif
+
+// records longer than the buffer are cut short
+char *CsvReader::read_raw_line(char *buff, int buffsize) {
+    const char *line;
+    size_t len;
+    if (buffsize < 1 || ! read_line_view(line,len)) {
+        return nullptr;
+    }
+    len = len < (size_t)buffsize - 1 ? len : buffsize - 1;
+    memcpy(buff,line,len);
+    buff[len] = 0;
+    return buff;
+}
+
+// whatever is buffered comes first, then the rest of the file
+size_t CsvReader::read(void *buff, int buffsize) {
+    if (fail()) return 0;
+    size_t n = end - start < (size_t)buffsize ? end - start : buffsize;
+    memcpy(buff,buf.data() + start,n);
+    start += n;
+    if (n < (size_t)buffsize && in != nullptr) {
+        buf_pos += end;
+        start = end = 0;
+        size_t m = fread((char*)buff + n,1,buffsize - n,in);
+        buf_pos += m;
+        n += m;
+    }
+    in_record = false;
+    pos = buf_pos + start;
+    return n;
+}
+
+long CsvReader::getpos() {
+    return pos;
+}
+
+void CsvReader::setpos(long p, char end) {
+    if (end == '$') {
+        fseek(in,p,SEEK_END);
+        p = ftell(in);
+    } else {
+        if (end == '.') {
+            p += pos;
+        }
+        fseek(in,p,SEEK_SET);
+    }
+    start = this->end = 0;
+    buf_pos = pos = p;
+    at_eof = false;
+    in_record = false;
+}
+
+}
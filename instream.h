@@ -5,16 +5,97 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <string>
+#include <vector>
+#include <type_traits>
+#include "tokenize.h"
+#include "byteorder.h"
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#if __cplusplus >= 202002L
+#include <span>
+#endif
 
 namespace stream {
+class Arena;
+
+/// what identifies a version of a file: its size, modification time in
+/// nanoseconds and inode
+struct FileStamp {
+   int64_t size;
+   int64_t mtime;
+   int64_t inode;
+};
+
+/// where each line starts, as far as the input has been scanned
+class LineIndex {
+   std::vector<long> starts;
+   long scanned;
+public:
+   LineIndex();
+   void clear();
+
+   /// the index covers [0,end())
+   long end() const { return scanned; }
+   /// lines known so far; the last may not be complete
+   size_t lines() const { return starts.size(); }
+   /// where line n (counting from 1) starts, or -1 if it isn't known yet
+   long line_start(size_t n) const;
+   /// the line holding p, which should be before end(), and where that line starts
+   size_t line_of(long p, long& start) const;
+
+   /// add the newlines in n bytes found at end()
+   void scan(const char *P, size_t n);
+   /// a line was read from end() up to `next`, which follows a newline if `newline`
+   void line_read(long next, bool newline);
+
+   /// the index goes with a particular size, modification time and inode of its input
+   bool save(const std::string& file, const FileStamp& stamp);
+   bool load(const std::string& file, const FileStamp& stamp);
+};
+
 class Reader {
 protected:
    FILE *in;
    bool owner;
    int fpos;
-   int pos;
+   long pos;
    int bad;
    std::string err_msg;
+   Arena *str_arena;
+   bool arena_owner;
+   char *line_buf;
+   size_t line_cap;
+   std::string word_buf;
+   Delims delims;
+   LineIndex line_index;
+   bool track_lines;
+   bool ahead;
+
+   Reader& check_read(const char *ctype, int res);
+   void line_read(long start, bool newline);
+   void index_to(long p, size_t line);
+   /// read up to n records, swapping their bytes if asked; fewer is an error unless
+   /// `to_end`, when only a record cut short is. Returns the whole records read
+   size_t read_bytes(void *p, size_t n, size_t width, bool swap, bool to_end);
+   /// bytes from here to the end, or -1 if that isn't known
+   long bytes_left();
+
+   /// up to n bytes of the input at `off` for the line index, without moving the
+   /// read position; they may be copied into `scratch`. Null if they can't be had
+   virtual const char *index_block(long off, std::string& scratch, size_t& n);
+   /// the size, modification time and inode that a saved line index must match;
+   /// mtime is 0 for input in memory, which never uses a side file
+   virtual bool index_stamp(FileStamp& stamp);
+
+   /// readers over memory that stays put for their lifetime can hand out views of it
+   virtual bool has_views();
+   /// the next word, as scanf would return for %s; it sets fpos to the number of
+   /// characters consumed, and the text is good until the next read (or longer, if has_views())
+   virtual int read_word(const char*& word, size_t& len);
+   /// the next line without its '\n', false at the end. This backs getline, getlines and skip;
+   /// the text is good until the next read, or as long as the reader if has_views()
+   virtual bool read_line_view(const char*& line, size_t& len);
 
 public:
    struct Error {
@@ -33,7 +114,7 @@ public:
    Reader(FILE *in);
    Reader(const char *file, const char *how="r");
    Reader(const std::string& file, const char *how="r");
-   ~Reader();
+   virtual ~Reader();
    void close();
 
    bool fail();
@@ -43,8 +124,18 @@ public:
    void set_error(const std::string& msg, int code);
 
    void set(FILE *new_in, bool own);
+
+   /// string_view results are kept in `a`, which must outlive them
+   Reader& use(Arena& a);
+   /// the arena for string_view results; our own, unless use() was called
+   Arena& arena();
    bool open(const std::string& file, const char *how="r");
 
+   /// words and numbers are also separated by these characters (at most four),
+   /// as well as whitespace. Words are found by the tokenizer, which works in
+   /// place on stdio's buffer for a FILE (with glibc), or on the text in memory
+   Reader& separators(const char *extra);
+
    virtual void close_handle();
    virtual int read_fmt(const char *fmt, va_list ap);
    virtual char *read_raw_line(char *buff, int buffsize);
@@ -53,7 +144,7 @@ public:
    template <typename T>
    Reader& read(T& data) {
     if (! fail()) {
-        size_t sz = fread(&data,1,sizeof(T),in);
+        size_t sz = read(&data,sizeof(T));
         if (sz != sizeof(T)) {
             set_error("expected " + std::to_string(sizeof(T)) + " got " + std::to_string(sz) + " bytes",EOF);
         }
@@ -61,6 +152,47 @@ public:
     return *this;
    } 
 
+   /// read n records straight into memory; with a byte order, as in
+   /// `read_records<big_endian>(p,n)`, numbers are converted after reading
+   template <Endian order=native_endian, class T>
+   Reader& read_records(T *p, size_t n) {
+      static_assert(std::is_trivially_copyable<T>::value,"records are read as bytes");
+      static_assert(order == native_endian || std::is_arithmetic<T>::value,"only numbers have a byte order");
+      read_bytes(p,n,sizeof(T),byte_swapped(order),false);
+      return *this;
+   }
+
+   /// append n records to `v`, or by default all the rest; when the size of the input
+   /// is known, `v` only grows once
+   template <Endian order=native_endian, class T>
+   Reader& read_records(std::vector<T>& v, size_t n=-1) {
+      static_assert(std::is_trivially_copyable<T>::value,"records are read as bytes");
+      static_assert(order == native_endian || std::is_arithmetic<T>::value,"only numbers have a byte order");
+      bool to_end = n == (size_t)-1;
+      long left = to_end ? bytes_left() : -1;
+      size_t have = v.size();
+      size_t block = ! to_end ? n : left >= 0 ? (left + sizeof(T) - 1)/sizeof(T) : record_block/sizeof(T) + 1;
+      for (;;) {
+         v.resize(have + block);
+         size_t got = read_bytes(v.data() + have,block,sizeof(T),byte_swapped(order),to_end);
+         have += got;
+         if (got < block || left >= 0 || ! to_end) break;
+      }
+      v.resize(have);
+      return *this;
+   }
+
+#if __cplusplus >= 202002L
+   template <Endian order=native_endian, class T, size_t E>
+   Reader& read_records(std::span<T,E> s) {
+      return read_records<order>(s.data(),s.size());
+   }
+#endif
+
+   /// bulk reads ask for the next block before reading this one, and the
+   /// system reads further ahead than usual
+   virtual Reader& readahead(bool on=true);
+
    Reader& formatted_read(const char *ctype, const char *def, const char *fmt, ...);
    Reader& conversion_error(const char *kind, uint64_t val, bool was_unsigned);
 
@@ -83,19 +215,37 @@ public:
    Reader& operator() (char &i,const char *fmt = nullptr);
    Reader& operator() (uint8_t &i,const char *fmt = nullptr);
    Reader& operator() (std::string &s,const char *fmt = nullptr);
+#if __cplusplus >= 201703L
+   Reader& operator() (std::string_view &s,const char *fmt = nullptr);
+#endif
    Reader& operator() (const char *extra);
    Reader& operator() ();
 
    Reader& getline(std::string& s);
+#if __cplusplus >= 201703L
+   /// the line is kept in arena(), so reading it doesn't touch the heap
+   Reader& getline(std::string_view& s);
+#endif
 
    Reader& skip(int lines=1);
 
-   LineInfo getlineinfo (long p=-1);
+   /// line and column of p (the current position by default), found with a
+   /// binary search of the line index, which is extended as far as p if need be
+   virtual LineInfo getlineinfo (long p=-1);
+   /// move to the start of line n, counting from 1
+   Reader& seek_line(size_t n);
+   /// keep the line index up to date as lines are read, so it needn't be rebuilt
+   Reader& index_lines(bool on=true);
+   /// the index of the whole input is saved to a side file, and can be loaded
+   /// when the same input is opened again; false if it doesn't match
+   bool save_index(const std::string& file);
+   bool load_index(const std::string& file);
 
-   template <class C>
+   /// lines are read as std::string; getlines<std::string_view>(c) keeps them in arena()
+   template <class T=std::string, class C>
    Reader& getlines(C& c, size_t lines=-1) {
       if (fail()) return *this;
-      std::string tmp;
+      T tmp;
       size_t i = 0;
       while (i < lines && getline(tmp)) {
          c.push_back(tmp);
@@ -121,20 +271,128 @@ public:
 const std::string cmd_ok = "> /dev/null && echo OK";
 const std::string cmd_retcode = "> /dev/null || echo $?";
 
+/// StrReader reads text which it either views, in which case the text must outlive
+/// the reader, or owns, when it is given a temporary string. The length is explicit,
+/// so the text needn't be NUL-terminated. Words and lines are read as views of the
+/// text, and finding a token costs no more than its own length.
 class StrReader: public Reader {
 protected:
    const char * pc;
    size_t size;
+   std::string own;
+
+   int next_word(const char*& word, size_t& len);
+   int scan_fmt(const char *fmt, va_list ap);
+   virtual bool has_views();
+   virtual int read_word(const char*& word, size_t& len);
+   virtual const char *index_block(long off, std::string& scratch, size_t& n);
+   virtual bool index_stamp(FileStamp& stamp);
 public:
    StrReader(const std::string& s);
+   StrReader(std::string&& s);
    StrReader(const char *pc);
+   StrReader(const char *pc, size_t size);
+#if __cplusplus >= 201703L
+   StrReader(std::string_view s);
+#endif
+   /// a copy would point into the original's text, which it may own
+   StrReader(const StrReader&) = delete;
+   StrReader& operator= (const StrReader&) = delete;
 
+   using Reader::read;
    virtual int read_fmt(const char *fmt, va_list ap);
    virtual char *read_raw_line(char *buff, int buffsize);
+   virtual size_t read(void *buff, int buffsize);
    virtual long getpos();
    virtual void setpos(long p, char end='^');
+
+   /// all of the text
+   const char *data() { return pc; }
+   size_t length() { return size; }
+protected:
+   virtual bool read_line_view(const char*& line, size_t& len);
 };
-}
-#endif
 
+/// MmapReader maps the whole file, so words and lines can be read as views
+/// straight from the mapping, good for as long as the reader lives; positions
+/// are simply offsets into it.
+class MmapReader: public StrReader {
+protected:
+   void *map;
+   size_t map_size;
+   FileStamp map_stamp;
+
+   void map_file(const char *file);
+
+   virtual int read_word(const char*& word, size_t& len);
+   virtual bool index_stamp(FileStamp& stamp);
+public:
+   MmapReader(const char *file);
+   MmapReader(const std::string& file);
+   /// read [start,end) of another reader's mapping, which must outlive this one;
+   /// positions and line info are still those of the whole file
+   MmapReader(MmapReader& whole, size_t start, size_t end);
+   virtual ~MmapReader();
+
+   virtual int read_fmt(const char *fmt, va_list ap);
+   virtual Reader& readahead(bool on=true);
+};
+
+/// CsvReader reads RFC 4180 records: each read takes the next field, whole, and
+/// numbers must fill their field. Fields run on into the next record, as words do
+/// over lines; () or skip() ends the current record, or skips the next one if
+/// none has been started. Quoted fields may hold the delimiter, newlines and ""
+/// for a quote; blank lines are ignored. Records are split in a block buffer that
+/// is kept for the next record, so fields are only good until then.
+class CsvReader: public Reader {
+protected:
+   char delim;
+   Delims record_stops;
+   std::string buf;
+   size_t start, end;
+   long buf_pos;
+   bool at_eof;
+   bool in_record;
+   size_t rec_start, rec_len;
+   long rec_off;
+   std::vector<FieldPos> spans;
+   std::string unquoted;           // quoted fields, unescaped
+   std::vector<long> unquoted_at;  // where each field is in unquoted, or -1 if it's in the record
+   size_t col;
 
+   void init();
+   bool fill();
+   bool find_record(size_t& rec_end, size_t& next);
+   void split_record();
+   const char *field_text(size_t i);
+   bool next_record();
+   int next_field(const char*& field, size_t& len);
+   void field_done();
+
+   virtual int read_word(const char*& word, size_t& len);
+   virtual bool read_line_view(const char*& line, size_t& len);
+public:
+   CsvReader(const char *file, char delim=',');
+   CsvReader(const std::string& file, char delim=',');
+   CsvReader(FILE *in, char delim=',');
+
+   /// the fields in the current record
+   size_t fields() { return in_record ? spans.size() : 0; }
+
+   /// the rest of the current record, or all of the next one; `values` is resized
+   /// and its strings keep their storage from the last row
+   CsvReader& row(std::vector<std::string>& values);
+#if __cplusplus >= 201703L
+   /// the views are into the record buffer, and are good until the next record
+   CsvReader& row(std::vector<std::string_view>& values);
+#endif
+
+   using Reader::read;
+   virtual int read_fmt(const char *fmt, va_list ap);
+   virtual char *read_raw_line(char *buff, int buffsize);
+   virtual size_t read(void *buff, int buffsize);
+   virtual long getpos();
+   virtual void setpos(long p, char end='^');
+};
+}
+#endif
@@ -0,0 +1,359 @@
+// Lightweight operator() overloading stdio wrapper
+// streaming JSON output through any Writer
+// Steve Donovan, (c) 2016
+// MIT license
+#include "json.h"
+#include "fastfmt.h"
+#include <charconv>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+
+namespace stream {
+
+// the characters that must be escaped are '"', '\\' and the controls below ' '
+static inline bool needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// how many characters from the start need no escaping, sixteen at a time
+static size_t clean_prefix(const char *s, size_t n) {
+    size_t i = 0;
+#ifdef HAVE_X86_SIMD
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i below_space = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v,quote),_mm_cmpeq_epi8(v,backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v,below_space),v)
+        );
+        int bits = _mm_movemask_epi8(m);
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (needs_escape(s[i])) break;
+    }
+    return i;
+}
+
+// `put` gets the clean runs and the escapes in turn
+template <class Put>
+static void escape_to(Put put, const char *s, size_t n) {
+    while (n > 0) {
+        size_t clean = clean_prefix(s,n);
+        if (clean > 0) {
+            put(s,clean);
+            s += clean;
+            n -= clean;
+            if (n == 0) break;
+        }
+        unsigned char c = *s;
+        char esc[8] = {'\\',0};
+        size_t len = 2;
+        switch (c) {
+        case '"': esc[1] = '"'; break;
+        case '\\': esc[1] = '\\'; break;
+        case '\n': esc[1] = 'n'; break;
+        case '\r': esc[1] = 'r'; break;
+        case '\t': esc[1] = 't'; break;
+        case '\b': esc[1] = 'b'; break;
+        case '\f': esc[1] = 'f'; break;
+        default:
+            memcpy(esc + 1,"u00",3);
+            esc[4] = "0123456789abcdef"[c >> 4];
+            esc[5] = "0123456789abcdef"[c & 0xF];
+            len = 6;
+        }
+        put(esc,len);
+        ++s;
+        --n;
+    }
+}
+
+void json_escape(Writer& out, const char *s, size_t n) {
+    escape_to([&](const char *p, size_t k) { out.raw(p,k); },s,n);
+}
+
+void JsonWriter::escape(const char *s, size_t n) {
+    escape_to([this](const char *p, size_t k) { put(p,k); },s,n);
+}
+
+// a Writeable writes its text through this, which escapes it on the way
+class JsonText: public Writer {
+    JsonWriter& js;
+public:
+    JsonText(JsonWriter& js) : Writer(stderr), js(js) { }
+
+    virtual void write_char(char ch) {
+        js.escape(&ch,1);
+    }
+
+    virtual void write_raw(const char *s, size_t n) {
+        js.escape(s,n);
+    }
+
+    virtual void write_out(const char *fmt, va_list ap) {
+        char buf[256];
+        va_list aq;
+        va_copy(aq,ap);
+        int n = vsnprintf(buf,sizeof(buf),fmt,ap);
+        if (n >= (int)sizeof(buf)) {
+            std::string big(n,'\0');
+            vsnprintf(&big[0],n + 1,fmt,aq);
+            js.escape(big.data(),n);
+        } else if (n > 0) {
+            js.escape(buf,n);
+        }
+        va_end(aq);
+    }
+
+    virtual void put_eoln() {
+        write_char('\n');
+    }
+
+    virtual Writer& flush() { return *this; }
+};
+
+JsonWriter::JsonWriter(Writer& out, JsonStyle style, int indent)
+  : out(out), style(style), indent(indent), first(true), keyed(false), pend_len(0)
+{
+}
+
+JsonWriter::~JsonWriter() {
+    spill();
+}
+
+// pass on what we have, and then `s` if it wouldn't fit either
+void JsonWriter::spill(const char *s, size_t n) {
+    if (pend_len > 0) {
+        out.raw(pend,pend_len);
+        pend_len = 0;
+    }
+    if (n >= sizeof(pend)) {
+        out.raw(s,n);
+    } else if (n > 0) {
+        memcpy(pend,s,n);
+        pend_len = n;
+    }
+}
+
+void JsonWriter::set_error(const char *msg) {
+    if (err_msg.empty()) {
+        err_msg = msg;
+    }
+}
+
+void JsonWriter::newline(size_t depth) {
+    static const char spaces[] = "                                ";
+    put("\n",1);
+    for (size_t n = depth*indent; n > 0; ) {
+        size_t k = n < sizeof(spaces) - 1 ? n : sizeof(spaces) - 1;
+        put(spaces,k);
+        n -= k;
+    }
+}
+
+// in an object, the key has already put in the comma; elsewhere we do
+bool JsonWriter::begin_value() {
+    if (! levels.empty() && levels.back() == '{') {
+        if (! keyed) {
+            set_error("value in an object needs a key");
+            return false;
+        }
+        keyed = false;
+        return true;
+    }
+    if (! levels.empty()) {
+        if (! first) put(",",1);
+        if (style == json_pretty) newline(levels.size());
+    }
+    first = false;
+    return true;
+}
+
+// a document at the top level ends its line
+void JsonWriter::end_value() {
+    if (levels.empty()) {
+        put("\n",1);
+        first = true;
+        spill();
+    }
+}
+
+JsonWriter& JsonWriter::key(std::string_view k) {
+    if (levels.empty() || levels.back() != '{') {
+        set_error("key outside an object");
+        return *this;
+    }
+    if (keyed) {
+        set_error("key without a value");
+        return *this;
+    }
+    if (! first) put(",",1);
+    if (style == json_pretty) newline(levels.size());
+    first = false;
+    string_out(k.data(),k.size());
+    if (style == json_pretty) {
+        put(": ",2);
+    } else {
+        put(":",1);
+    }
+    keyed = true;
+    return *this;
+}
+
+void JsonWriter::string_out(const char *s, size_t n) {
+    put("\"",1);
+    escape(s,n);
+    put("\"",1);
+}
+
+JsonWriter& JsonWriter::open(char bracket) {
+    if (begin_value()) {
+        put(&bracket,1);
+        levels.push_back(bracket);
+        first = true;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::object() {
+    return open('{');
+}
+
+JsonWriter& JsonWriter::array() {
+    return open('[');
+}
+
+JsonWriter& JsonWriter::object(std::string_view k) {
+    return key(k).open('{');
+}
+
+JsonWriter& JsonWriter::array(std::string_view k) {
+    return key(k).open('[');
+}
+
+// an empty object or array stays on one line
+JsonWriter& JsonWriter::end() {
+    if (levels.empty()) {
+        set_error("nothing to end");
+        return *this;
+    }
+    if (keyed) {
+        set_error("key without a value");
+        keyed = false;
+    }
+    char close = levels.back() == '{' ? '}' : ']';
+    levels.pop_back();
+    if (! first && style == json_pretty) {
+        newline(levels.size());
+    }
+    put(&close,1);
+    first = false;
+    end_value();
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_all() {
+    while (! levels.empty()) {
+        end();
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(const char *s, size_t n) {
+    if (begin_value()) {
+        put(s,n);
+        end_value();
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json) {
+    return number(json.data(),json.size());
+}
+
+JsonWriter& JsonWriter::operator() (std::string_view s) {
+    if (begin_value()) {
+        string_out(s.data(),s.size());
+        end_value();
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::operator() (const char *s) {
+    if (s == nullptr) {
+        return number("null",4);
+    }
+    return (*this)(std::string_view(s));
+}
+
+JsonWriter& JsonWriter::operator() (std::nullptr_t) {
+    return number("null",4);
+}
+
+JsonWriter& JsonWriter::operator() (bool b) {
+    return b ? number("true",4) : number("false",5);
+}
+
+JsonWriter& JsonWriter::operator() (int32_t i) {
+    return (*this)((int64_t)i);
+}
+
+JsonWriter& JsonWriter::operator() (uint32_t i) {
+    return (*this)((uint64_t)i);
+}
+
+JsonWriter& JsonWriter::operator() (int64_t i) {
+    char buf[num_buf_size];
+    return number(buf,format_i64(buf,i));
+}
+
+JsonWriter& JsonWriter::operator() (uint64_t i) {
+    char buf[num_buf_size];
+    return number(buf,format_u64(buf,i));
+}
+
+// to_chars gives the shortest digits that read back as the same value
+JsonWriter& JsonWriter::operator() (double x) {
+    if (! isfinite(x)) {
+        return number("null",4);
+    }
+    char buf[num_buf_size];
+    std::to_chars_result res = std::to_chars(buf,buf + sizeof(buf),x);
+    return number(buf,res.ptr - buf);
+}
+
+JsonWriter& JsonWriter::operator() (float x) {
+    if (! isfinite(x)) {
+        return number("null",4);
+    }
+    char buf[num_buf_size];
+    std::to_chars_result res = std::to_chars(buf,buf + sizeof(buf),x);
+    return number(buf,res.ptr - buf);
+}
+
+JsonWriter& JsonWriter::operator() (const Writeable& w, const char *fmt) {
+    if (begin_value()) {
+        put("\"",1);
+        JsonText text(*this);
+        w.write_to(text,fmt);
+        put("\"",1);
+        end_value();
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::operator() (const JsonWriteable& w) {
+    w.write_json(*this);
+    return *this;
+}
+
+}
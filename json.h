@@ -0,0 +1,131 @@
+// Lightweight operator() overloading stdio wrapper
+// streaming JSON output through any Writer
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_JSON_H
+#define __OUTSTREAM_JSON_H
+#include "outstream.h"
+#include <string.h>
+#include <string_view>
+#include <vector>
+
+namespace stream {
+
+class JsonWriter;
+
+/// implement this interface for your type to be written as JSON structure;
+/// a plain Writeable is written as a string
+class JsonWriteable {
+public:
+    virtual void write_json(JsonWriter& js) const = 0;
+};
+
+enum JsonStyle { json_compact, json_pretty };
+
+/// JsonWriter streams JSON to a Writer as it goes, so it only keeps the open
+/// objects and arrays, and a small buffer so that the Writer gets text in pieces
+/// rather than a token at a time. Inside an object, a key comes before each value; `js(key,value)`
+/// does both. Each document at the top level ends with a newline, so compact
+/// output is one document per line. Strings are escaped; numbers are written
+/// in the shortest form that reads back exactly, and NaN and infinity as null.
+class JsonWriter {
+protected:
+    Writer& out;
+    JsonStyle style;
+    int indent;
+    std::vector<char> levels;  // '{' or '[' for each one open
+    bool first;                // nothing yet in the innermost one
+    bool keyed;                // a key is waiting for its value
+    std::string err_msg;
+    char pend[256];
+    size_t pend_len;
+
+    void put(const char *s, size_t n) {
+        if (n > sizeof(pend) - pend_len) {
+            spill(s,n);
+        } else {
+            memcpy(pend + pend_len,s,n);
+            pend_len += n;
+        }
+    }
+    void spill(const char *s=nullptr, size_t n=0);
+    void escape(const char *s, size_t n);
+    friend class JsonText;
+    void set_error(const char *msg);
+    void newline(size_t depth);
+    bool begin_value();
+    void end_value();
+    void string_out(const char *s, size_t n);
+    JsonWriter& number(const char *s, size_t n);
+    JsonWriter& open(char bracket);
+public:
+    /// pretty output puts each member on its own line, `indent` spaces in per level
+    JsonWriter(Writer& out, JsonStyle style=json_compact, int indent=2);
+    ~JsonWriter();
+
+    /// start an object or array, as the next value
+    JsonWriter& object();
+    JsonWriter& array();
+    /// start one as the value of `k` in the current object
+    JsonWriter& object(std::string_view k);
+    JsonWriter& array(std::string_view k);
+    /// close the innermost object or array
+    JsonWriter& end();
+    /// close all that are open
+    JsonWriter& end_all();
+
+    JsonWriter& key(std::string_view k);
+
+    JsonWriter& operator() (std::string_view s);
+    JsonWriter& operator() (const std::string& s) { return (*this)(std::string_view(s)); }
+    /// a null pointer is null
+    JsonWriter& operator() (const char *s);
+    JsonWriter& operator() (bool b);
+    JsonWriter& operator() (int32_t i);
+    JsonWriter& operator() (uint32_t i);
+    JsonWriter& operator() (int64_t i);
+    JsonWriter& operator() (uint64_t i);
+    JsonWriter& operator() (double x);
+    JsonWriter& operator() (float x);
+    JsonWriter& operator() (std::nullptr_t);
+    /// the text of a Writeable, as a string, escaped as it is written
+    JsonWriter& operator() (const Writeable& w, const char *fmt=nullptr);
+    JsonWriter& operator() (const JsonWriteable& w);
+    /// text that is already JSON
+    JsonWriter& raw(std::string_view json);
+
+    template <class V>
+    JsonWriter& operator() (std::string_view k, const V& v) {
+        key(k);
+        return (*this)(v);
+    }
+
+    /// a range becomes an array
+    template <class It>
+    JsonWriter& operator() (const Range_<It>& rr) {
+        array();
+        for (It ii = rr.begin; ii != rr.end; ++ii) {
+            (*this)(*ii);
+        }
+        return end();
+    }
+
+    template <class T>
+    JsonWriter& operator() (const std::vector<T>& v) {
+        return (*this)(range(v));
+    }
+
+    /// misuse, like a value in an object without a key, or end() with nothing open
+    bool fail() { return ! err_msg.empty(); }
+    operator bool () { return ! fail(); }
+    std::string error() { return err_msg; }
+    size_t depth() { return levels.size(); }
+    JsonWriter& flush() { spill(); out.flush(); return *this; }
+};
+
+/// the escaped form of `s`, without quotes, as JsonWriter writes it
+void json_escape(Writer& out, const char *s, size_t n);
+
+}
+#endif
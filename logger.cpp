@@ -1,28 +1,136 @@
 #include "logger.h"
+#include "concurrent.h"
 #include <log4cpp/Category.hh>
 #include <log4cpp/PropertyConfigurator.hh>
 #include <log4cpp/Priority.hh>
+#include <memory>
 using namespace std;
+using namespace stream;
 
 static log4cpp::Category* plogger;
 
+struct LogRecord {
+    log4cpp::Priority::Value level;
+    string msg;
+};
+
+// records go through a lock-free ring to a single background thread;
+// strings are swapped in and out, so there is no copying
+class AsyncLog {
+    MpscRing<LogRecord> ring;
+    logging::Overflow overflow;
+    atomic<uint64_t> queued;
+    atomic<uint64_t> logged;
+    atomic<uint64_t> ndropped;
+    atomic<bool> done;
+    thread worker;
+
+    void run() {
+        LogRecord rec;
+        uint64_t n = 0, reported = 0;
+        int tries = 0;
+        for (;;) {
+            if (ring.pop(rec)) {
+                plogger->log(rec.level,rec.msg);
+                rec.msg.clear();
+                logged.store(++n,memory_order_release);
+                tries = 0;
+                continue;
+            }
+            uint64_t nd = ndropped.load(memory_order_relaxed);
+            if (nd != reported) {
+                StrWriter sw(' ');
+                sw("dropped")(nd - reported)("log records");
+                plogger->log(log4cpp::Priority::WARN,sw.str());
+                reported = nd;
+            }
+            if (done.load(memory_order_acquire) && queued.load(memory_order_acquire) == n) {
+                break;
+            }
+            ring_backoff(tries);
+        }
+    }
+
+public:
+    AsyncLog(size_t size, logging::Overflow overflow)
+        : ring(size), overflow(overflow), queued(0), logged(0), ndropped(0),
+          done(false), worker(&AsyncLog::run,this)
+    {
+    }
+
+    ~AsyncLog() {
+        done.store(true,memory_order_release);
+        worker.join();
+    }
+
+    void log(log4cpp::Priority::Value level, string& msg) {
+        LogRecord rec;
+        rec.level = level;
+        rec.msg.swap(msg);
+        int tries = 0;
+        while (! ring.push(rec)) {
+            if (overflow != logging::overflow_block) {
+                if (overflow == logging::overflow_count) {
+                    ndropped.fetch_add(1,memory_order_relaxed);
+                }
+                msg.swap(rec.msg);
+                msg.clear();
+                return;
+            }
+            ring_backoff(tries);
+        }
+        msg.swap(rec.msg); // get back a recycled string
+        queued.fetch_add(1,memory_order_release);
+    }
+
+    void flush() {
+        uint64_t n = queued.load(memory_order_acquire);
+        int tries = 0;
+        while (logged.load(memory_order_acquire) < n) {
+            ring_backoff(tries);
+        }
+    }
+
+    uint64_t dropped() {
+        return ndropped.load(memory_order_relaxed);
+    }
+};
+
+static AsyncLog *async_log;
+
 class LogWriter: public StrWriter {
     log4cpp::Priority::PriorityLevel level;
 public:
     LogWriter(log4cpp::Priority::PriorityLevel level) : StrWriter(' '),level(level) {}
         
     virtual void put_eoln() {
-        plogger->log(level,"%s",str().c_str());
+        if (async_log) {
+            async_log->log(level,s);
+        } else {
+            plogger->log(level,s);
+        }
         clear();
     }
 };
 
+// runs before log4cpp's own shutdown, since it was registered later
+static void stop_async_log() {
+    delete async_log;
+    async_log = nullptr;
+}
+
 namespace logging {
+    // a running worker is stopped and joined before log4cpp is reconfigured
     bool initialize_logging(string log_properties) {
+        static bool registered = false;
+        stop_async_log();
         try {    
            log4cpp::PropertyConfigurator::configure(log_properties);    
            plogger = &(log4cpp::Category::getInstance("testlog"));    
-           atexit (log4cpp::Category::shutdown); 
+           if (! registered) {
+               atexit (log4cpp::Category::shutdown); 
+               registered = true;
+           }
            return true;
         } catch(log4cpp::ConfigureFailure& err)  {
            errs("log4cpp")(err.what())();
@@ -31,10 +139,49 @@ namespace logging {
         
         
     }
-    Writer& error = *new LogWriter(log4cpp::Priority::ERROR);
-    Writer& warn = *new LogWriter(log4cpp::Priority::WARN);
-    Writer& info = *new LogWriter(log4cpp::Priority::INFO);
-    Writer& debug = *new LogWriter(log4cpp::Priority::DEBUG);
-    Writer& notice = *new LogWriter(log4cpp::Priority::NOTICE);
+
+    bool initialize_logging(string log_properties, size_t queue_size, Overflow overflow) {
+        static bool registered = false;
+        if (! initialize_logging(log_properties)) {
+            return false;
+        }
+        async_log = new AsyncLog(queue_size,overflow);
+        if (! registered) {
+            atexit(stop_async_log);
+            registered = true;
+        }
+        return true;
+    }
+
+    void flush_logging() {
+        if (async_log) {
+            async_log->flush();
+        }
+    }
+
+    uint64_t dropped() {
+        return async_log ? async_log->dropped() : 0;
+    }
+
+    static const log4cpp::Priority::PriorityLevel levels[] = {
+        log4cpp::Priority::ERROR, log4cpp::Priority::WARN, log4cpp::Priority::NOTICE,
+        log4cpp::Priority::INFO, log4cpp::Priority::DEBUG
+    };
+
+    // made on first use in each thread; a partial record is lost when the thread exits
+    Writer& LogLevel::local() {
+        thread_local unique_ptr<LogWriter> writers[5];
+        unique_ptr<LogWriter>& w = writers[index];
+        if (! w) {
+            w.reset(new LogWriter(levels[index]));
+        }
+        return *w;
+    }
+
+    LogLevel error(0);
+    LogLevel warn(1);
+    LogLevel notice(2);
+    LogLevel info(3);
+    LogLevel debug(4);
         
-}
\ No newline at end of file
+}
@@ -2,12 +2,49 @@
 #define _LOGGER_H
 #include "outstream.h"
 namespace logging {
+    using stream::Writer;
+
+    /// what an async logger does when its queue is full
+    enum Overflow {
+        overflow_block,  // wait for the background thread to catch up
+        overflow_drop,   // silently discard the record
+        overflow_count   // discard, count, and report the count as a warning
+    };
+
+    /// this may be called again to reconfigure, but not while other threads are logging
     bool initialize_logging(std::string log_properties);
-    
-    extern Writer& error;
-    extern Writer& warn;
-    extern Writer& notice;
-    extern Writer& info;
-    extern Writer& debug;
+
+    /// records go on a bounded queue of `queue_size` and are passed to
+    /// log4cpp by a background thread, so the caller only pays for formatting
+    bool initialize_logging(std::string log_properties, size_t queue_size, Overflow overflow=overflow_block);
+
+    /// wait until every queued record has been logged
+    void flush_logging();
+
+    /// number of records discarded with overflow_count
+    uint64_t dropped();
+
+    /// a log level. Each thread formats its records in its own Writer, and only
+    /// finished records are passed on, so `warn("x")(i)()` is safe from any thread
+    class LogLevel {
+        int index;
+    public:
+        explicit LogLevel(int index) : index(index) { }
+
+        /// the calling thread's Writer for this level
+        Writer& local();
+        operator Writer& () { return local(); }
+
+        template <class... Args>
+        Writer& operator() (const Args&... args) {
+            return local()(args...);
+        }
+    };
+
+    extern LogLevel error;
+    extern LogLevel warn;
+    extern LogLevel notice;
+    extern LogLevel info;
+    extern LogLevel debug;
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,58 @@
+// latency of a logging call, synchronous against asynchronous
+#include "logger.h"
+#include <algorithm>
+#include <vector>
+#include <time.h>
+using namespace std;
+using namespace stream;
+
+static uint64_t nanosecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return 1000000000L*ts.tv_sec + ts.tv_nsec;
+}
+
+const int N = 200000;
+
+// percentiles and a power-of-two histogram of the time taken by each call
+void measure(const char *mode) {
+    vector<uint64_t> times(N);
+    for (int i = 0; i < N; i++) {
+        uint64_t start = nanosecs();
+        logging::warn("request")(i)("took")(1.5*i)("ms")();
+        times[i] = nanosecs() - start;
+    }
+    logging::flush_logging();
+
+    vector<int> buckets(40);
+    for (uint64_t ns : times) {
+        int b = 0;
+        while (ns > 1) {
+            ns >>= 1;
+            ++b;
+        }
+        buckets[b]++;
+    }
+    sort(times.begin(),times.end());
+    outs(mode)("p50")(times[N/2])("p99")(times[N*99/100])("p99.9")(times[N*999/1000])
+        ("max")(times[N-1])("ns")();
+    for (size_t b = 0; b < buckets.size(); b++) {
+        if (buckets[b] > 0) {
+            outs("  <")((uint64_t)2 << b,"%8" PRIu64)("ns")(buckets[b],"%7d")
+                (string(buckets[b]*60/N,'#'))();
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    outs.sep(' ');
+    string config = "loglatency.properties";
+    if (! logging::initialize_logging(config)) {
+        return 1;
+    }
+    measure("sync");
+    logging::initialize_logging(config,1<<16,logging::overflow_block);
+    measure("async");
+    return 0;
+}
@@ -2,8 +2,18 @@
 // Steve Donovan, (c) 2016
 // MIT license
 #include "outstream.h"
+#include "fastfmt.h"
+#if __cplusplus >= 201703L
+#include "arena.h"
+#endif
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 using namespace std;
 extern "C" char *strerror(int);
+#ifndef va_copy
+#define va_copy __va_copy
+#endif
 
 namespace stream {
 
@@ -13,20 +23,116 @@ string Writeable::to_string(const char* fmt) {
    return sw.str();
 }
 
+const string& Writeable::to_string(StrWriter& sw, const char* fmt) const {
+   sw.clear();
+   write_to(sw,fmt);
+   return sw.text();
+}
+
 string Writer::error() {
     return strerror(errno);
 }
 
+// default buffer sizes for wrapped streams, and files we open ourselves
+const size_t line_buffer_size = 4096;
+const size_t file_buffer_size = 65536;
+
+void Writer::init_buffer(size_t size, bool line) {
+    obuf = nullptr;
+    obuf_size = size;
+    obuf_len = 0;
+    by_line = line;
+}
+
+// the buffer is only allocated when first needed, since derived
+// writers like StrWriter never use it
+static char *alloc_buffer(char *&obuf, size_t size) {
+    if (obuf == nullptr) {
+        obuf = new char[size];
+    }
+    return obuf;
+}
+
+void Writer::flush_buffer() {
+    if (via != nullptr) {
+        via->flush_buffer();
+        return;
+    }
+    if (obuf_len > 0 && out != nullptr) {
+        fwrite(obuf,1,obuf_len,out);
+    }
+    obuf_len = 0;
+}
+
+Writer& Writer::buffering(size_t size, bool line) {
+    flush_buffer();
+    delete[] obuf;
+    init_buffer(size,line);
+    return *this;
+}
+
 void Writer::write_char(char ch) {
-    fputc(ch,out);
+    if (via != nullptr) {
+        via->write_char(ch);
+        return;
+    }
+    if (obuf_size == 0) {
+        fputc(ch,out);
+        return;
+    }
+    if (obuf_len == obuf_size) {
+        flush_buffer();
+    }
+    alloc_buffer(obuf,obuf_size)[obuf_len++] = ch;
+}
+
+void Writer::write_raw(const char *s, size_t n) {
+    if (via != nullptr) {
+        via->write_raw(s,n);
+        return;
+    }
+    if (obuf_size - obuf_len < n) {
+        flush_buffer();
+        if (n >= obuf_size) { // too big to be worth copying
+            fwrite(s,1,n,out);
+            return;
+        }
+    }
+    memcpy(alloc_buffer(obuf,obuf_size) + obuf_len,s,n);
+    obuf_len += n;
 }
 
 void Writer::put_eoln() {
     write_char('\n');
+    if (by_line) {
+        flush_buffer();
+    }
 }
 
 void Writer::write_out(const char *fmt, va_list ap) {
-    vfprintf(out,fmt,ap);
+    if (via != nullptr) {
+        via->write_out(fmt,ap);
+        return;
+    }
+    if (obuf_size == 0) {
+        vfprintf(out,fmt,ap);
+        return;
+    }
+    va_list aq;
+    va_copy(aq,ap);
+    size_t avail = obuf_size - obuf_len;
+    int nch = vsnprintf(alloc_buffer(obuf,obuf_size) + obuf_len,avail,fmt,ap);
+    if (nch >= 0 && (size_t)nch < avail) {
+        obuf_len += nch;
+    } else {
+        flush_buffer();
+        if (nch >= 0 && (size_t)nch < obuf_size) {
+            obuf_len = vsnprintf(obuf,obuf_size,fmt,aq);
+        } else {
+            vfprintf(out,fmt,aq);
+        }
+    }
+    va_end(aq);
 }
 
 Writer& Writer::fmt(const char *fmtstr,...) {
@@ -51,63 +157,260 @@ void Writer::sep_out() {
     }
 }
 
-Writer& Writer::formatted_write(const char *def, const char *fmt,...) {
-    char copy_def[30];
+// the default format `def` as hex, with at least two digits for "XX" and "xx"
+static const char *hex_format(const char *def, const char *fmt, char *copy_def) {
+    const char *in = def;
+    char *out = copy_def;
+    if (fmt[1]) {
+        *out++ = *in++;
+        *out++ = '0';  *out++ = '2';
+    }
+    while (*(in+1))  *out++ = *in++;
+    if (*in == 'c') { // special case - characters as bytes
+        *out++ = 'h';   *out++ = 'h';
+    }
+    *out++ = fmt[0];
+    *out = 0;
+    return copy_def;
+}
+
+const char *field_format(const char *def, const char *fmt, char *copy_def) {
+    if (fmt!=nullptr && def[1] != 's' && (fmt[0] == 'x' || fmt[0] == 'X')
+        && (fmt[1] == 0 || (fmt[1] == fmt[0] && fmt[2] == 0))) { // numbers as hex
+        fmt = hex_format(def,fmt,copy_def);
+    } else
     if (fmt!=nullptr && fmt[1]==0) { // one-character special shortcut format codes
         if (def[1] == 's') { // 'quote' or "quote" strings
             if (fmt[0] == 'q') fmt = "'%s'"; else
             if (fmt[0] == 'Q') fmt = "\"%s\"";
         } else {
-            if (fmt[0] == 'x' || fmt[0] == 'X') { // numbers as hex
-                const char *in = def;
-                char *out = copy_def;
-                while (*(in+1))  *out++ = *in++;
-                if (*in == 'c') { // special case - characters as bytes
-                    *out++ = 'h';   *out++ = 'h';
-                }
-                *out++ = fmt[0];
-                *out = 0;
-                fmt = copy_def;
-            } else {
-                fmt = nullptr;
-            }
+            fmt = nullptr;
         }
     }
+    return fmt ? fmt : def;
+}
+
+Writer& Writer::formatted_write(const char *def, const char *fmt,...) {
+    char copy_def[30];
+    const char *spec = field_format(def,fmt,copy_def);
     sep_out();
     va_list ap;
     va_start(ap,fmt);
-    write_out(fmt ? fmt : def,ap);
+    write_out(spec,ap);
     va_end(ap);
     return *this;
 }
 
+Writer& Writer::raw_field(const char *s, size_t n) {
+    sep_out();
+    write_raw(s,n);
+    return *this;
+}
+
+Writer& Writer::int_field(int64_t i) {
+    char buf[num_buf_size];
+    return raw_field(buf,format_i64(buf,i));
+}
+
+Writer& Writer::uint_field(uint64_t i) {
+    char buf[num_buf_size];
+    return raw_field(buf,format_u64(buf,i));
+}
+
+Writer& Writer::hex_field(uint64_t i, const char *fmt) {
+    char buf[num_buf_size];
+    return raw_field(buf,format_hex(buf,i,fmt[0] == 'X',fmt[1] ? 2 : 1));
+}
+
+Writer& Writer::double_field(double x) {
+    char buf[num_buf_size];
+    return raw_field(buf,format_g(buf,x));
+}
+
+// a run of numbers is formatted into blocks of about this size, which are
+// each written out in one piece
+const size_t number_block = 4096;
+
+struct HexFmt {
+    bool on;
+    bool upper;
+    int digits;
+};
+
+// each number is formatted as the scalar operator() would, once promoted to
+// the type that overload takes
+static size_t format_value(char *buf, int32_t v, const HexFmt& h) {
+    return h.on ? format_hex(buf,(uint32_t)v,h.upper,h.digits) : format_i64(buf,v);
+}
+
+static size_t format_value(char *buf, uint32_t v, const HexFmt& h) {
+    return h.on ? format_hex(buf,v,h.upper,h.digits) : format_u64(buf,v);
+}
+
+static size_t format_value(char *buf, int64_t v, const HexFmt& h) {
+    return h.on ? format_hex(buf,(uint64_t)v,h.upper,h.digits) : format_i64(buf,v);
+}
+
+static size_t format_value(char *buf, uint64_t v, const HexFmt& h) {
+    return h.on ? format_hex(buf,v,h.upper,h.digits) : format_u64(buf,v);
+}
+
+static size_t format_value(char *buf, char v, const HexFmt& h) {
+    return format_hex(buf,(unsigned char)v,h.upper,h.digits);
+}
+
+static size_t format_value(char *buf, double x, const HexFmt&) {
+    return format_g(buf,x);
+}
+
+// as many numbers from the i-th on as fill a block
+template <class S, class V>
+static size_t format_block(char *buf, const void *p, size_t& i, size_t n, char sepr, const HexFmt& h) {
+    const S *P = (const S*)p;
+    size_t len = 0;
+    for (; i < n && len < number_block; ++i) {
+        if (i > 0 && sepr != 0) {
+            buf[len++] = sepr;
+        }
+        len += format_value(buf + len,(V)P[i],h);
+    }
+    return len;
+}
+
+template <class S, class V>
+static void each_value(Writer& w, const void *p, size_t n, const char *fmt) {
+    const S *P = (const S*)p;
+    for (size_t i = 0; i < n; ++i) {
+        w((V)P[i],fmt);
+    }
+}
+
+typedef size_t (*FormatBlock)(char *buf, const void *p, size_t& i, size_t n, char sepr, const HexFmt& h);
+typedef void (*EachValue)(Writer& w, const void *p, size_t n, const char *fmt);
+
+// the element type S of a run, and the type V it is promoted to
+#define NUMBER_TYPES(fn) \
+    switch (kind) { \
+    case 'c': return fn<char,char>; \
+    case 'f': return width == 4 ? fn<float,double> : fn<double,double>; \
+    case 'i': \
+        if (width == 1) return fn<signed char,int32_t>; \
+        if (width == 2) return fn<int16_t,int32_t>; \
+        if (width == 4) return fn<int32_t,int32_t>; \
+        return fn<int64_t,int64_t>; \
+    default: \
+        if (width == 1) return fn<uint8_t,int32_t>; \
+        if (width == 2) return fn<uint16_t,int32_t>; \
+        if (width == 4) return fn<uint32_t,uint32_t>; \
+        return fn<uint64_t,uint64_t>; \
+    }
+
+static FormatBlock format_block_for(size_t width, char kind) {
+    NUMBER_TYPES(format_block)
+}
+
+static EachValue each_value_for(size_t width, char kind) {
+    NUMBER_TYPES(each_value)
+}
+
+// bytes as a hex dump are converted sixteen at a time by format_hex_bytes
+Writer& Writer::number_run(const void *p, size_t n, size_t width, char kind, const char *fmt) {
+    char buf[number_block + num_buf_size + 1];
+    char sepr = sepc;
+    HexFmt h = {fmt != nullptr, fmt != nullptr && fmt[0] == 'X', fmt != nullptr && fmt[1] ? 2 : 1};
+    if (h.digits == 2 && width == 1 && kind != 'i') {
+        const unsigned char *P = (const unsigned char*)p;
+        const size_t per = number_block/3;
+        for (size_t i = 0; i < n; i += per) {
+            size_t len = 0;
+            if (i > 0 && sepr != 0) {
+                buf[len++] = sepr;
+            }
+            len += format_hex_bytes(buf + len,P + i,n - i < per ? n - i : per,h.upper,sepr);
+            write_raw(buf,len);
+        }
+    } else {
+        FormatBlock format = format_block_for(width,kind);
+        size_t i = 0;
+        while (i < n) {
+            write_raw(buf,format(buf,p,i,n,sepr,h));
+        }
+    }
+    eoln = false;
+    if (n > 1 && sepr != 0) {
+        next_sepc = sepr;
+    }
+    return *this;
+}
+
+Writer& Writer::each_number(const void *p, size_t n, size_t width, char kind, const char *fmt) {
+    each_value_for(width,kind)(*this,p,n,fmt);
+    return *this;
+}
+
+// wrapped streams hand over complete lines, so that output still
+// interleaves sensibly with stdio; stderr is left unbuffered as usual
 Writer::Writer(FILE *out,char sep)
-    : out(out),sepc(sep),eoln(true),owner(false),old_sepc(0),next_sepc(0)
+    : out(out),sepc(sep),eoln(true),owner(false),old_sepc(0),next_sepc(0),behind_mark(-1),behind_prev(-1),via(nullptr)
 {
+    init_buffer(out == stderr ? 0 : line_buffer_size,true);
 }
 
 Writer::Writer(const char *file, const char *how)
-    : out(fopen(file,how)), sepc(0), eoln(true), owner(true),old_sepc(0),next_sepc(0)
+    : out(fopen(file,how)), sepc(0), eoln(true), owner(true),old_sepc(0),next_sepc(0),behind_mark(-1),behind_prev(-1),via(nullptr)
 {
+    init_buffer(file_buffer_size,false);
 }
 
 Writer::Writer(const string& file, const char *how)
-    : out(fopen(file.c_str(),how)), sepc(0), eoln(true), owner(true),old_sepc(0),next_sepc(0)
+    : out(fopen(file.c_str(),how)), sepc(0), eoln(true), owner(true),old_sepc(0),next_sepc(0),behind_mark(-1),behind_prev(-1),via(nullptr)
 {
+    init_buffer(file_buffer_size,false);
+}
+
+// a copy writes through the original, so that their text comes out in order
+Writer::Writer(const Writer& w)
+    : out(w.out),sepc(w.sepc),eoln(w.eoln),owner(false),old_sepc(w.old_sepc),next_sepc(w.next_sepc),behind_mark(-1),behind_prev(-1),
+      via(w.via ? w.via : const_cast<Writer*>(&w))
+{
+    init_buffer(0,w.by_line);
 }
 
 Writer::Writer(const Writer& w, char sepc)
-    : out(w.out),sepc(sepc),eoln(w.eoln),owner(false),old_sepc(0),next_sepc(0)
+    : out(w.out),sepc(sepc),eoln(w.eoln),owner(false),old_sepc(0),next_sepc(0),behind_mark(-1),behind_prev(-1),
+      via(w.via ? w.via : const_cast<Writer*>(&w))
 {
+    init_buffer(0,w.by_line);
 }
 
 Writer::~Writer() {
+    flush_buffer();
     close();
+    delete[] obuf;
+    // a static writer may still be used by later static destructors
+    init_buffer(0,false);
+}
+
+FILE *Writer::stream() {
+    if (via != nullptr) {
+        return via->stream();
+    }
+    flush_buffer();
+    return out;
+}
+
+int Writer::handle_fd() {
+    if (via != nullptr) {
+        return via->handle_fd();
+    }
+    return out != nullptr ? fileno(out) : -1;
 }
 
 void Writer::close() {
+    flush_buffer();
     if (owner && out != nullptr) {
         fclose(out);
+        out = nullptr;
     }
 }
 
@@ -139,6 +442,23 @@ Writer& Writer::restore_sep(char sepr) {
     return *this;
 }
 
+Writer& Writer::pass_line(Writer& w) {
+    w.sepc = sepc;
+    w.next_sepc = next_sepc;
+    w.eoln = eoln;
+    return w;
+}
+
+// the text was written to us in one piece, so a line that it ended wasn't flushed
+Writer& Writer::take_line(const Writer& w) {
+    next_sepc = w.next_sepc;
+    eoln = w.eoln;
+    if (eoln && by_line) {
+        flush_buffer();
+    }
+    return *this;
+}
+
 Writer& Writer::operator() () {
     eoln = true;
     put_eoln();
@@ -147,12 +467,13 @@ Writer& Writer::operator() () {
 }
 
 Writer& Writer::flush() {
+    flush_buffer();
     fflush(out);
     return *this;
 }
 
 long Writer::getpos() {
-    return ftell(out);
+    return ftell(out) + obuf_len;
 }
 
 void Writer::setpos(long p, char end) {
@@ -163,18 +484,80 @@ void Writer::setpos(long p, char end) {
     if (end == '.') {
         whence = SEEK_CUR;
     }
+    flush_buffer();
     fseek(out,p,whence);
 }
 
-int Writer::write(void *buf, int bufsize) {
+int Writer::write(const void *buf, int bufsize) {
+    flush_buffer();
     return fwrite(buf, bufsize, 1, out);
 }
 
+// records go out in blocks, so that write-behind can follow them; a block is
+// too big for our buffer, so unless it is converted it is written from where it is
+Writer& Writer::write_bytes(const void *p, size_t n, size_t width, bool swap) {
+    const char *P = (const char*)p;
+    size_t bytes = n*width;
+    size_t block = width < record_block ? record_block - record_block % width : width;
+    void *conv = nullptr;
+    if (swap && width > 1 && posix_memalign(&conv,4096,block) != 0) {
+        return *this;
+    }
+    while (bytes > 0) {
+        size_t len = bytes < block ? bytes : block;
+        if (conv != nullptr) {
+            memcpy(conv,P,len);
+            swap_bytes(conv,len/width,width);
+            write_raw((const char*)conv,len);
+        } else {
+            write_raw(P,len);
+        }
+        P += len;
+        bytes -= len;
+        if (behind_mark != -1) {
+            write_behind();
+        }
+    }
+    free(conv);
+    return *this;
+}
+
+// once a block has been written since the last mark, start it on its way to
+// disk; the block before it has had time to get there, so wait for that one
+// and drop it from the page cache
+// positions and flushing go through the virtual methods, so that this also
+// works for writers like FdWriter that have no FILE underneath
+void Writer::write_behind() {
+    long end = getpos();
+    if (end - behind_mark < (long)record_block) return;
+    flush();
+#ifdef __linux__
+    int fd = handle_fd();
+    sync_file_range(fd,behind_mark,end - behind_mark,SYNC_FILE_RANGE_WRITE);
+    if (behind_prev < behind_mark) {
+        sync_file_range(fd,behind_prev,behind_mark - behind_prev,
+            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(fd,behind_prev,behind_mark - behind_prev,POSIX_FADV_DONTNEED);
+    }
+#endif
+    behind_prev = behind_mark;
+    behind_mark = end;
+}
+
+Writer& Writer::writebehind(bool on) {
+    behind_mark = behind_prev = -1;
+    struct stat st;
+    int fd = handle_fd();
+    if (on && fd != -1 && fstat(fd,&st) == 0 && S_ISREG(st.st_mode)) {
+        flush();
+        behind_mark = behind_prev = getpos();
+    }
+    return *this;
+}
+
 Writer outs(stdout,' ');
 Writer errs(stderr,' ');
 
-static char buf[128];
-
 StrWriter::StrWriter(char sepr, size_t capacity) : Writer(stderr) {
     if (capacity != 0) {
         s.reserve(capacity);
@@ -186,27 +569,152 @@ void StrWriter::write_char(char ch) {
     s += ch;
 }
 
+// format straight into the string's spare room, which is kept small since
+// resize() has to clear it; std::string grows geometrically as needed.
+// If the field doesn't fit, we know its exact size and try again.
+const size_t str_room = 256;
+
 void StrWriter::write_out(const char *fmt, va_list ap) {
-    int nch = vsnprintf(buf,sizeof(buf),fmt,ap);
-    s.append(buf,nch);
+    va_list aq;
+    va_copy(aq,ap);
+    size_t len = s.size();
+    size_t room = s.capacity() - len;
+    if (room < 64) room = 64;
+    if (room > str_room) room = str_room;
+    s.resize(len + room);
+    int nch = vsnprintf(&s[len],room,fmt,ap);
+    if (nch < 0) {
+        nch = 0;
+    } else
+    if ((size_t)nch >= room) {
+        s.resize(len + nch + 1);
+        vsnprintf(&s[len],nch + 1,fmt,aq);
+    }
+    s.resize(len + nch);
+    va_end(aq);
+}
+
+void StrWriter::write_raw(const char *str, size_t n) {
+    s.append(str,n);
 }
 
-BufWriter::BufWriter(char *buff, int size, char sepr): Writer(stderr), P(buff),P_end(buff+size) {
+#if __cplusplus >= 201703L
+std::string_view StrWriter::take(Arena& arena) {
+    std::string_view res = arena.keep(s);
+    s.clear();
+    return res;
+}
+#endif
+
+BufWriter::BufWriter(char *buff, int size, char sepr)
+    : Writer(stderr), buff(buff), size(size > 0 ? size : 0), spill_fn(nullptr), spill_data(nullptr)
+{
     sep(sepr);
+    reset();
+}
+
+BufWriter& BufWriter::reset() {
+    P = buff;
+    P_end = buff + (size > 0 ? size - 1 : 0);
+    total = 0;
+    trunc = false;
+    out = stderr;
+    eoln = true;
+    return *this;
+}
+
+static void append_spill(void *data, const char *s, size_t n) {
+    ((string*)data)->append(s,n);
+}
+
+BufWriter& BufWriter::spill(string& overflow) {
+    return spill(append_spill,&overflow);
+}
+
+BufWriter& BufWriter::spill(Spill fn, void *data) {
+    spill_fn = fn;
+    spill_data = data;
+    return *this;
+}
+
+void BufWriter::spill_buffer() {
+    if (P > buff) {
+        spill_fn(spill_data,buff,P - buff);
+        P = buff;
+    }
+}
+
+void BufWriter::put(const char *s, size_t n) {
+    total += n;
+    if (n <= (size_t)(P_end - P)) {
+        memcpy(P,s,n);
+        P += n;
+        return;
+    }
+    if (spill_fn != nullptr) {
+        spill_buffer();
+        if (n <= (size_t)(P_end - P)) {
+            memcpy(P,s,n);
+            P += n;
+        } else {
+            spill_fn(spill_data,s,n);
+        }
+    } else {
+        size_t room = P_end - P;
+        memcpy(P,s,room);
+        P += room;
+        trunc = true;
+        out = nullptr;
+    }
 }
 
 void BufWriter::write_char(char ch) {
-    *P++ = ch;
+    put(&ch,1);
+}
+
+void BufWriter::write_raw(const char *s, size_t n) {
+    put(s,n);
 }
 
 void BufWriter::write_out(const char *fmt, va_list ap) {
-    int nch = vsnprintf(P,sizeof(buf),fmt,ap);
-    char *next = P + nch;
-    if (next < P_end) {
-        P = next;
-    } else {
+    va_list aq;
+    va_copy(aq,ap);
+    size_t room = P_end - P;
+    int nch = vsnprintf(P,room + (size > 0),fmt,ap);
+    if (nch < 0) {
+        nch = 0;
+    }
+    if ((size_t)nch <= room) {
+        P += nch;
+        total += nch;
+    } else
+    if (spill_fn == nullptr) { // vsnprintf has already written what fits
+        P = P_end;
+        total += nch;
+        trunc = true;
         out = nullptr;
+    } else
+    if ((size_t)nch <= (size_t)(P_end - buff)) {
+        spill_buffer();
+        vsnprintf(P,nch + 1,fmt,aq);
+        P += nch;
+        total += nch;
+    } else {
+        string tmp(nch,'\0');
+        vsnprintf(&tmp[0],nch + 1,fmt,aq);
+        put(tmp.data(),nch);
     }
+    va_end(aq);
+}
+
+Writer& BufWriter::flush() {
+    if (spill_fn != nullptr) {
+        spill_buffer();
+    }
+    if (size > 0) {
+        *P = '\0';
+    }
+    return *this;
 }
 
 }
@@ -5,28 +5,48 @@
 #ifndef __OUTSTREAM_H
 #define __OUTSTREAM_H
 #include <string>
+#include "byteorder.h"
 #ifndef OLD_STD_CPP
 #include <initializer_list>
+#include <type_traits>
+#include <vector>
 #else
 #define nullptr NULL
 #include <errno.h>
 #endif
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#if __cplusplus >= 202002L
+#include "fmtstring.h"
+#include <iterator>
+#include <span>
+#endif
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 namespace stream {
 
 class Writer;
+class StrWriter;
+class Arena;
 
 /// implement this interface for your type to be printable with outstreams
 class Writeable {
 public:
    virtual void write_to(Writer&,const char*) const = 0;
    std::string to_string(const char* fmt = nullptr);
+   /// reuse `sw` (which is cleared first) rather than building a new string
+   const std::string& to_string(StrWriter& sw, const char* fmt = nullptr) const;
 };
 
+/// the printf format for a field of a type whose own format is `def`, given the
+/// format asked for; the one-letter shortcuts are expanded into `copy` (30 chars)
+const char *field_format(const char *def, const char *fmt, char *copy);
+
 template <typename It>
 struct Range_ {
    It begin;
@@ -56,13 +76,64 @@ protected:
     bool owner;
     char old_sepc;
     char next_sepc;
+    char *obuf;
+    size_t obuf_size;
+    size_t obuf_len;
+    bool by_line;
+    long behind_mark;
+    long behind_prev;
+    Writer *via;   // a copy passes its text to the writer it was copied from
+#ifdef OLD_STD_CPP
+    Writer& operator= (const Writer& w); // not defined
+#endif
 
     virtual void write_char(char ch);
     virtual void write_out(const char *fmt, va_list ap);
+    virtual void write_raw(const char *s, size_t n);
     virtual void put_eoln();
 
     void sep_out();
     Writer& formatted_write(const char *def, const char *fmt,...);
+    void init_buffer(size_t size, bool line);
+    void flush_buffer();
+    Writer& write_bytes(const void *p, size_t n, size_t width, bool swap);
+    void write_behind();
+    /// the descriptor underneath, for write-behind; -1 if there isn't one
+    virtual int handle_fd();
+
+    // fast paths for the default formats and the hex formats;
+    // these can be overriden to capture typed values before formatting
+    static bool is_hex(const char *fmt) {
+        return (fmt[0] == 'x' || fmt[0] == 'X') && (fmt[1] == 0 || (fmt[1] == fmt[0] && fmt[2] == 0));
+    }
+    Writer& raw_field(const char *s, size_t n);
+    virtual Writer& int_field(int64_t i);
+    virtual Writer& uint_field(uint64_t i);
+    virtual Writer& hex_field(uint64_t i, const char *fmt);
+    virtual Writer& double_field(double x);
+
+    /// `n` numbers in a row, each `width` bytes, of a `kind` given by number_kind();
+    /// `fmt` is null or a hex format. They are formatted a block at a time, and
+    /// separated by the current separator (there is none before the first)
+    virtual Writer& number_run(const void *p, size_t n, size_t width, char kind, const char *fmt);
+    /// the same, but passing each number to operator() in turn, for writers that
+    /// capture typed values
+    Writer& each_number(const void *p, size_t n, size_t width, char kind, const char *fmt);
+
+#if __cplusplus >= 202002L
+    /// 'i' signed, 'u' unsigned, 'f' floating, 'c' char; 0 for anything else,
+    /// which is written an element at a time
+    template <class T>
+    static constexpr char number_kind() {
+        if (std::is_same_v<T,char>) return 'c';
+        if (std::is_same_v<T,float> || std::is_same_v<T,double>) return 'f';
+        if (std::is_same_v<T,signed char> || std::is_same_v<T,int16_t> ||
+            std::is_same_v<T,int32_t> || std::is_same_v<T,int64_t>) return 'i';
+        if (std::is_same_v<T,unsigned char> || std::is_same_v<T,uint16_t> ||
+            std::is_same_v<T,uint32_t> || std::is_same_v<T,uint64_t>) return 'u';
+        return 0;
+    }
+#endif
 
 public:
     /// wrap a stdio stream, with optional field separator
@@ -73,32 +144,63 @@ public:
     Writer(const char *file, const char *how="w");
     Writer(const std::string& file, const char *how="w");
 
+    // copies write through the original (which must outlive them), so text
+    // from both comes out in the order it was written
+    Writer(const Writer& w);
     Writer(const Writer& w, char sepc);
+#ifndef OLD_STD_CPP
+    Writer& operator= (const Writer& w) = delete;
+#endif
 
     virtual ~Writer();
 
-    // access to the stdio stream
-    FILE *stream() { return out; }
+    // access to the stdio stream; anything we have buffered is passed on first
+    virtual FILE *stream();
     // this object fails if there's no stream defined
     operator bool () { return out != nullptr; }
     // provide actual error string
     std::string error();
 
-    void close();
+    virtual void close();
     Writer& set(FILE *nout);
 
+    /// format into our own buffer of `size` bytes, and only pass it to the stream
+    /// when full, on flush(), or at the end of each line if `line` is true.
+    /// Size 0 means every field goes straight to the stream.
+    virtual Writer& buffering(size_t size, bool line=false);
+
     /// simple wrapper over `fprintf`, same limitations
     Writer& fmt(const char *fmtstr,...);
 
+#if __cplusplus >= 202002L
+    /// like fmt(), but the format is parsed and type-checked at compile time
+    template <FmtString F, typename... Args>
+    Writer& fmt(const Args&... args) {
+        emit_format<F>(*this,args...);
+        return *this;
+    }
+#endif
+
+    /// write text that is already formatted, with no separator
+    Writer& raw(const char *s, size_t n) {
+        write_raw(s,n);
+        return *this;
+    }
+
     ///// Field Separator Control /////
     /// set the field separator (default none)
     Writer& sep(int ch = 0);
     /// reset the field separator
     char reset_sep(char sep=0);
     Writer& restore_sep(char sepr);
+    /// `w` carries on the current line for us, with our separator, and take_line
+    /// picks up where it left off; print() formats into a stack buffer like this
+    Writer& pass_line(Writer& w);
+    Writer& take_line(const Writer& w);
 
     /// overloads of operator() for various types
     Writer& operator() (const char *s, const char *fmt=nullptr) {
+        if (fmt == nullptr && s != nullptr) return raw_field(s,strlen(s));
         return formatted_write("%s",fmt,s);
     }
 
@@ -106,28 +208,46 @@ public:
         return (*this)(s.c_str(),fmt);
     }
 
+#if __cplusplus >= 201703L
+    Writer& operator() (std::string_view s, const char *fmt=nullptr) {
+        if (fmt == nullptr) return raw_field(s.data(),s.size());
+        return (*this)(std::string(s).c_str(),fmt);
+    }
+#endif
+
     Writer& operator() (int32_t i, const char *fmt=nullptr) {
+        if (fmt == nullptr) return int_field(i);
+        if (is_hex(fmt)) return hex_field((uint32_t)i,fmt);
         return formatted_write("%" PRIi32,fmt,i);
     }
 
     Writer& operator() (uint32_t i, const char *fmt=nullptr) {
+        if (fmt == nullptr) return uint_field(i);
+        if (is_hex(fmt)) return hex_field(i,fmt);
         return formatted_write("%" PRIu32,fmt,i);
     }
     
     Writer& operator() (char ch, const char *fmt=nullptr) {
-        if (ch == '\n') return (*this)();
+        if (ch == '\n' && fmt == nullptr) return (*this)();
+        if (fmt == nullptr) return raw_field(&ch,1);
+        if (is_hex(fmt)) return hex_field((unsigned char)ch,fmt);
         return formatted_write("%c",fmt,ch);
     }
 
     Writer& operator() (uint64_t i, const char *fmt=nullptr) {
+        if (fmt == nullptr) return uint_field(i);
+        if (is_hex(fmt)) return hex_field(i,fmt);
         return formatted_write("%" PRIu64,fmt,i);
     }
 
     Writer& operator() (int64_t i, const char *fmt=nullptr) {
+        if (fmt == nullptr) return int_field(i);
+        if (is_hex(fmt)) return hex_field((uint64_t)i,fmt);
         return formatted_write("%" PRIi64,fmt,i);
     }
 
     Writer& operator() (double x, const char *fmt=nullptr) {
+        if (fmt == nullptr) return double_field(x);
         return formatted_write("%g",fmt,x);
     }
 
@@ -152,7 +272,34 @@ public:
     /// empty operator() means 'end of line'; use ('\n') as an equivalent form if this is too terse
     Writer& operator() ();
 
-    int write(void *buf, int bufsize);
+    virtual int write(const void *buf, int bufsize);
+
+#ifndef OLD_STD_CPP
+    /// write n records just as they are in memory. With a byte order, as in
+    /// `write_records<big_endian>(v)`, numbers are converted in a separate buffer
+    template <Endian order=native_endian, class T>
+    Writer& write_records(const T *p, size_t n) {
+        static_assert(std::is_trivially_copyable<T>::value,"records are written as bytes");
+        static_assert(order == native_endian || std::is_arithmetic<T>::value,"only numbers have a byte order");
+        return write_bytes(p,n,sizeof(T),byte_swapped(order));
+    }
+
+    template <Endian order=native_endian, class T>
+    Writer& write_records(const std::vector<T>& v) {
+        return write_records<order>(v.data(),v.size());
+    }
+#endif
+#if __cplusplus >= 202002L
+    template <Endian order=native_endian, class T, size_t E>
+    Writer& write_records(std::span<T,E> s) {
+        return write_records<order>(s.data(),s.size());
+    }
+#endif
+
+    /// records written to a file are passed to the disk as they go, a few megabytes
+    /// at a time, and dropped from the page cache once written, so a big dump
+    /// doesn't fill memory with dirty pages
+    Writer& writebehind(bool on=true);
 
     /// flush the stream _explicitly_
    virtual Writer& flush();
@@ -174,6 +321,17 @@ public:
     Writer& operator() (const Range_<It>& rr, const char *fmt=nullptr, char sepr=' ') {
         sep_out();
         char osep = reset_sep(sepr);
+#if __cplusplus >= 202002L
+        // numbers in contiguous memory go as a run, unless a char is to be written as itself
+        if constexpr (std::contiguous_iterator<It>) {
+            typedef std::iter_value_t<It> T;
+            constexpr char kind = number_kind<T>();
+            if (kind != 0 && rr.begin != rr.end && (fmt == nullptr ? kind != 'c' : kind != 'f' && is_hex(fmt))) {
+                number_run(std::to_address(rr.begin),rr.end - rr.begin,sizeof(T),kind,fmt);
+                return restore_sep(osep);
+            }
+        }
+#endif
         It ii = rr.begin;
         for(;  ii != rr.end; ++ii) {
             (*this)(*ii,fmt);
@@ -194,33 +352,78 @@ extern Writer outs;
 extern Writer errs;
 
 class StrWriter: public Writer {
+protected:
     std::string s;
 public:
     StrWriter(char sepr=0, size_t capacity = 0);
 
     std::string str() { return s; }
+    const std::string& text() const { return s; }
     operator std::string () { return s; }
-    void clear() { s.clear(); }
+    /// empty the string and start a new line
+    void clear() { s.clear(); eoln = true; next_sepc = 0; }
+#if __cplusplus >= 201703L
+    /// move the text into `arena` and clear, keeping our capacity for the next one;
+    /// the view is good until the arena is reset
+    std::string_view take(Arena& arena);
+#endif
 
     virtual void write_char(char ch);
     virtual void write_out(const char *fmt, va_list ap);
+    virtual void write_raw(const char *s, size_t n);
     virtual Writer& flush() { return *this; }
 };
 
+/// BufWriter writes into a fixed buffer, always leaving room for the final NUL.
+/// By default, output that doesn't fit is truncated, and the writer converts to false;
+/// needed() says how much room would have been required. Alternatively, a full
+/// buffer can be spilled to a string or a callback and reused.
 class BufWriter: public Writer {
+public:
+    /// receives text that has been spilled from the buffer
+    typedef void (*Spill)(void *data, const char *s, size_t n);
+protected:
+    char *buff;
     char *P;
     char *P_end;
+    size_t size;
+    size_t total;
+    bool trunc;
+    Spill spill_fn;
+    void *spill_data;
+
+    void put(const char *s, size_t n);
+    void spill_buffer();
 public:
     BufWriter(char *buff, int size, char sep=0);
 
+    /// when the buffer is full, move its contents to the end of `overflow`
+    BufWriter& spill(std::string& overflow);
+    /// when the buffer is full, pass its contents to `fn`
+    BufWriter& spill(Spill fn, void *data);
+
+    /// was anything lost?
+    bool truncated() const { return trunc; }
+    /// bytes written (or attempted) since the start, not counting the NUL
+    size_t needed() const { return total; }
+    /// bytes currently in the buffer
+    size_t length() const { return P - buff; }
+    /// start again at the beginning of the buffer
+    BufWriter& reset();
+
     virtual void write_char(char ch);
     virtual void write_out(const char *fmt, va_list ap);
-    virtual Writer& flush() { *P++ = '\0'; return *this; }
+    virtual void write_raw(const char *s, size_t n);
+    /// NUL-terminate the buffer, after spilling its contents if spilling
+    virtual Writer& flush();
 };
 
 typedef const char *str_t_;
 const str_t_ hex_u="X";
 const str_t_ hex_l="x";
+/// hex with at least two digits, so that a range of bytes is a hex dump
+const str_t_ hex_bytes_u="XX";
+const str_t_ hex_bytes_l="xx";
 const str_t_ quote_d="Q";
 const str_t_ quote_s="q";
 const char eol='\n';
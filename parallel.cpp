@@ -0,0 +1,129 @@
+// Lightweight operator() overloading stdio wrapper
+// reading a big file with many threads, a chunk of lines each
+// Steve Donovan, (c) 2016
+// MIT license
+#include "parallel.h"
+#include <string.h>
+
+namespace stream {
+
+ParallelReader::ParallelReader(const char *file, int threads, size_t chunk_size)
+  : whole(file), nthreads(threads), next_chunk(0), err_chunk(0), err({0,"",0})
+{
+    if (nthreads <= 0) {
+        nthreads = std::thread::hardware_concurrency();
+        if (nthreads <= 0) nthreads = 1;
+    }
+    if (whole.fail()) {
+        whole(err);
+    }
+    // a chunk ends just after the first newline past its target size
+    size_t size = whole.length();
+    size_t target = size/(4*nthreads);
+    if (target < chunk_size) target = chunk_size;
+    const char *data = whole.data();
+    bounds.push_back(0);
+    size_t p = 0;
+    while (p < size) {
+        size_t q = p + target;
+        if (q >= size) {
+            q = size;
+        } else {
+            const char *nl = (const char*)memchr(data + q,'\n',size - q);
+            q = nl ? nl - data + 1 : size;
+        }
+        bounds.push_back(q);
+        p = q;
+    }
+    if (bounds.size() == 1) {
+        bounds.push_back(0);
+    }
+}
+
+// chunks are handed out in order, to whichever worker is free
+void ParallelReader::start(std::function<void(MmapReader&,size_t)> work) {
+    done.assign(chunks(),0);
+    next_chunk = 0;
+    thrown = nullptr;
+    if (! whole.fail()) {
+        err = Reader::Error{0,"",0};
+    }
+    int n = nthreads < (int)chunks() ? nthreads : (int)chunks();
+    for (int t = 0; t < n; ++t) {
+        workers.push_back(std::thread([this,work]() {
+            for (;;) {
+                size_t i;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (next_chunk == chunks()) return;
+                    i = next_chunk++;
+                }
+                MmapReader rdr(whole,bounds[i],bounds[i+1]);
+                try {
+                    work(rdr,i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (! thrown) {
+                        thrown = std::current_exception();
+                    }
+                    next_chunk = chunks();
+                    chunk_done.notify_all();
+                    return;
+                }
+                Reader::Error e;
+                rdr(e);
+                std::lock_guard<std::mutex> guard(lock);
+                if (e.errcode != 0 && e.errcode != EOF && (err.errcode == 0 || i < err_chunk)) {
+                    err = e;
+                    err_chunk = i;
+                }
+                done[i] = 1;
+                chunk_done.notify_all();
+            }
+        }));
+    }
+}
+
+// a chunk whose worker threw is never done, so its exception is thrown instead
+void ParallelReader::wait_chunk(size_t i) {
+    std::exception_ptr e;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        chunk_done.wait(guard,[&]() { return done[i] != 0 || thrown; });
+        if (done[i] != 0) return;
+        e = thrown;
+    }
+    std::rethrow_exception(e);
+}
+
+void ParallelReader::finish() {
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    workers.clear();
+}
+
+// the chunks already being read are finished
+void ParallelReader::cancel() {
+    std::lock_guard<std::mutex> guard(lock);
+    next_chunk = chunks();
+}
+
+bool ParallelReader::fail() {
+    return err.errcode != 0;
+}
+
+std::string ParallelReader::error() {
+    return err.msg;
+}
+
+ParallelReader& ParallelReader::operator() (Reader::Error& e) {
+    e = err;
+    return *this;
+}
+
+Reader::LineInfo ParallelReader::getlineinfo(long p) {
+    return whole.getlineinfo(p);
+}
+
+}
@@ -0,0 +1,109 @@
+// Lightweight operator() overloading stdio wrapper
+// reading a big file with many threads, a chunk of lines each
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_PARALLEL_H
+#define __OUTSTREAM_PARALLEL_H
+#include "instream.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stream {
+
+/// ParallelReader maps a file and splits it into chunks which end at newlines.
+/// Each chunk is read by a worker thread with its own MmapReader over that part
+/// of the mapping, so positions, errors and line info are those of the whole file.
+/// Results can be taken as they come, or in file order on the calling thread.
+class ParallelReader {
+    MmapReader whole;
+    int nthreads;
+    std::vector<size_t> bounds;
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable chunk_done;
+    std::vector<char> done;
+    size_t next_chunk;
+    size_t err_chunk;
+    Reader::Error err;
+    std::exception_ptr thrown;   // the first exception from a worker, rethrown on the calling thread
+
+    void start(std::function<void(MmapReader&,size_t)> work);
+    void wait_chunk(size_t i);
+    void finish();
+    void cancel();
+
+    // however in_order is left, no more chunks are started and the workers are joined
+    struct Cancel {
+        ParallelReader& pr;
+        ~Cancel() {
+            pr.cancel();
+            pr.finish();
+        }
+    };
+public:
+    /// `threads` defaults to the number of cores; chunks are at least `chunk_size`
+    /// bytes, and there are a few per thread so that they even out
+    ParallelReader(const char *file, int threads=0, size_t chunk_size=1024*1024);
+
+    size_t chunks() { return bounds.size() - 1; }
+    int threads() { return nthreads; }
+
+    /// the first error in the file, not counting the EOF at the end of each chunk
+    bool fail();
+    operator bool () { return ! fail(); }
+    std::string error();
+    ParallelReader& operator() (Reader::Error& e);
+    Reader::LineInfo getlineinfo(long p);
+
+    /// `fn(rdr)` reads one chunk, on a worker thread, in no particular order.
+    /// If it throws, no more chunks are started, and the exception is rethrown here
+    template <class Fn>
+    ParallelReader& each(Fn fn) {
+        start([&](MmapReader& rdr, size_t) { fn(rdr); });
+        finish();
+        if (thrown) {
+            std::rethrow_exception(thrown);
+        }
+        return *this;
+    }
+
+    /// `parse(rdr,result)` reads one chunk on a worker thread, and `deliver(result)`
+    /// gets the results in file order, on this thread, as soon as each is ready.
+    /// An exception from either stops the reading, and is thrown from here
+    template <class T, class Parse, class Deliver>
+    ParallelReader& in_order(Parse parse, Deliver deliver) {
+        std::vector<T> results(chunks());
+        start([&](MmapReader& rdr, size_t i) { parse(rdr,results[i]); });
+        Cancel joined = {*this};
+        for (size_t i = 0; i < results.size(); ++i) {
+            wait_chunk(i);
+            deliver(results[i]);
+            results[i] = T();
+        }
+        return *this;
+    }
+
+    /// like getlines, each chunk is parsed into a container, and these are appended to `c` in order
+    template <class C, class Parse>
+    ParallelReader& collect(C& c, Parse parse) {
+        return in_order<C>(parse,[&](C& part) {
+            c.insert(c.end(),part.begin(),part.end());
+        });
+    }
+
+    /// getlines<std::string_view>(c) gets views into the mapping
+    template <class T=std::string, class C>
+    ParallelReader& getlines(C& c) {
+        return collect(c,[](MmapReader& rdr, C& part) {
+            rdr.template getlines<T>(part);
+        });
+    }
+};
+
+}
+#endif
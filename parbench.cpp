@@ -0,0 +1,62 @@
+// reading one big file with more and more threads, against a single MmapReader
+#include "parallel.h"
+#include "outstream.h"
+#include <atomic>
+#include <time.h>
+using namespace std;
+using namespace stream;
+
+static uint64_t millisecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return 1000L*ts.tv_sec + ts.tv_nsec/1000000L;
+}
+
+const int N = 4000000;
+const char *file = "p.dat";
+
+void make_file() {
+    Writer w(file);
+    w.sep(' ');
+    for (int i = 0; i < N; i++) {
+        w(i)(i*0.25)("row")(1000.0/(i+1))(i*3)();
+    }
+}
+
+// the same work for each reader, whichever thread it is on; the sum is
+// of integers, so that it doesn't depend on the order of the chunks
+int64_t read_rows(MmapReader& rdr) {
+    int64_t i, j, sum = 0;
+    double x, y;
+    string_view s;
+    while (rdr(i)(x)(s)(y)(j)) {
+        sum += i + (int64_t)x + (int64_t)y + j;
+    }
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    make_file();
+    uint64_t start = millisecs();
+    MmapReader rdr(file);
+    int64_t sum = read_rows(rdr);
+    uint64_t one_ms = millisecs() - start;
+    outs("MmapReader ")(one_ms,"%5d")("ms")("sum")(sum)();
+    int cores = thread::hardware_concurrency();
+    outs("cores")(cores)();
+    for (int t = 1; t <= 2*cores || t <= 4; t *= 2) {
+        ParallelReader par(file,t);
+        start = millisecs();
+        int64_t total = 0;
+        par.in_order<int64_t>(
+            [](MmapReader& rdr, int64_t& part) { part = read_rows(rdr); },
+            [&](int64_t& part) { total += part; }
+        );
+        uint64_t ms = millisecs() - start;
+        outs("threads")(t,"%3d")("chunks")(par.chunks(),"%3d")(ms,"%5d")("ms")
+            ("speedup")((double)one_ms/(ms ? ms : 1),"%5.2f")("sum")(total)();
+    }
+    remove(file);
+    return 0;
+}
@@ -1,4 +1,4 @@
-// A simple print function for C++11
+// A simple print function for C++17
 #include "print.h"
 using namespace std;
 using namespace stream;
@@ -13,5 +13,12 @@ int main()
 
    print("answer in hex",fmt(answer,hex_u),fmt(x,"%5.2f"))('\n');
 
+   const char *none = nullptr;
+   print("no string",none,answer)('\n');
+
+   StrWriter sw(',');
+   println_to(sw,"one",2,3.5);
+   print(sw.str());
+
    return 0;
 }
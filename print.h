@@ -4,6 +4,9 @@
 #ifndef __OUTSTREAM_PRINT_H
 #define __OUTSTREAM_PRINT_H
 #include "outstream.h"
+#include <string_view>
+#include <type_traits>
+#include <utility>
 namespace stream {
    template <typename T>
     struct Fmt_ {
@@ -17,21 +20,79 @@ namespace stream {
         return Fmt_<T>(v,f);
     }
 
+    /// a print whose fields are sure to fit is formatted here on the stack, and
+    /// written out in one piece
+    const size_t print_buffer_size = 512;
+
+    /// the most room a field can need; anything we can't tell is too big
+    template <typename T>
+    size_t print_bound(const T& v) {
+        if constexpr (std::is_same<T,char>::value) {
+            return 1;
+        } else if constexpr (std::is_arithmetic<T>::value) {
+            return 32;
+        } else if constexpr (std::is_pointer<T>::value && std::is_convertible<T,const char*>::value) {
+            // a null string is written by printf as "(null)"
+            return v != nullptr ? strlen(v) : 6;
+        } else if constexpr (std::is_convertible<const T&,std::string_view>::value) {
+            return std::string_view(v).size();
+        } else {
+            return print_buffer_size;
+        }
+    }
+
+    // a format may set a width, which we allow for; if a field does turn out
+    // bigger, the buffer spills into the writer
     template <typename T>
-    Writer& print(T v) {
-        return outs(v);
+    size_t print_bound(const Fmt_<T>& vf) {
+        return print_bound(vf.v) + 32;
     }
 
     template <typename T>
-    Writer& print(const Fmt_<T>& vf) {
-        return outs(vf.v,vf.fmt);
+    void print_field(Writer& w, const T& v) {
+        w(v);
+    }
+
+    template <typename T>
+    void print_field(Writer& w, const Fmt_<T>& vf) {
+        w(vf.v,vf.fmt);
+    }
+
+    inline void print_spill(void *w, const char *s, size_t n) {
+        ((Writer*)w)->raw(s,n);
+    }
+
+    /// print the values to `w`, separated as it separates fields
+    template <typename... Args>
+    Writer& print_to(Writer& w, Args&&... args) {
+        size_t bound = (print_bound(args) + ... + sizeof...(Args));
+        if (bound >= print_buffer_size) {
+            (print_field(w,std::forward<Args>(args)), ...);
+            return w;
+        }
+        char buff[print_buffer_size];
+        BufWriter part(buff,sizeof(buff));
+        part.spill(print_spill,&w);
+        w.pass_line(part);
+        (print_field(part,std::forward<Args>(args)), ...);
+        w.raw(buff,part.length());
+        return w.take_line(part);
+    }
+
+    template <typename... Args>
+    Writer& println_to(Writer& w, Args&&... args) {
+        return print_to(w,std::forward<Args>(args)...,eol);
+    }
+
+    template <typename... Args>
+    Writer& print(Args&&... args) {
+        return print_to(outs,std::forward<Args>(args)...);
     }
 
-    template <typename T, typename... Args>
-    Writer& print(T first, Args... args) {
-        print(first);
-        return print(args...);
+    template <typename... Args>
+    Writer& println(Args&&... args) {
+        return print_to(outs,std::forward<Args>(args)...,eol);
     }
 
 }
-#endif
\ No newline at end of file
+#endif
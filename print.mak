@@ -1,8 +1,8 @@
 # print template
-STD=c++11
+STD=c++17
 CXXFLAGS = -std=$(STD) -g $(DEFINES)
-OUTSTREAM = outstream.o
-LDFLAGS = outstream.o
+OUTSTREAM = outstream.o fastfmt.o
+LDFLAGS = outstream.o fastfmt.o
 TARGET = print
 
 $(TARGET): $(TARGET).o $(OUTSTREAM)
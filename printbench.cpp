@@ -0,0 +1,88 @@
+// print() formatting a whole call on the stack, against printing field by
+// field as print() used to, and against fprintf
+#include "print.h"
+#include <time.h>
+using namespace std;
+using namespace stream;
+
+static uint64_t millisecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return 1000L*ts.tv_sec + ts.tv_nsec/1000000L;
+}
+
+const int N = 2000000;
+string name = "a longer string than fits inline";
+
+// the old print: each argument copied and passed to the writer in turn
+template <typename T>
+Writer& print_each(Writer& w, T v) {
+    return w(v);
+}
+
+template <typename T>
+Writer& print_each(Writer& w, const Fmt_<T>& vf) {
+    return w(vf.v,vf.fmt);
+}
+
+template <typename T, typename... Args>
+Writer& print_each(Writer& w, T first, Args... args) {
+    print_each(w,first);
+    return print_each(w,args...);
+}
+
+// buffered as usual, or with every write going to stdio
+size_t bufsize;
+
+void test_print(const char *file) {
+    Writer w(file);
+    w.buffering(bufsize);
+    w.sep(' ');
+    for (int i = 0; i < N; i++) {
+        print_to(w,"row",i,i*0.25,name,fmt(i,hex_u),'\n');
+    }
+}
+
+void test_each(const char *file) {
+    Writer w(file);
+    w.buffering(bufsize);
+    w.sep(' ');
+    for (int i = 0; i < N; i++) {
+        print_each(w,"row",i,i*0.25,name,fmt(i,hex_u),'\n');
+    }
+}
+
+void test_printf(const char *file) {
+    FILE *out = fopen(file,"w");
+    for (int i = 0; i < N; i++) {
+        fprintf(out,"row %d %g %s %X\n",i,i*0.25,name.c_str(),i);
+    }
+    fclose(out);
+}
+
+uint64_t timeit(const char *name, void (*test)(const char*), const char *file) {
+    uint64_t start = millisecs();
+    test(file);
+    uint64_t diff = millisecs() - start;
+    outs(name)(diff,"%5d")("ms")();
+    return diff;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t printf_ms = timeit("fprintf            ",test_printf,"p3.dat");
+    for (size_t size : {65536, 0}) {
+        bufsize = size;
+        outs("Writer buffer")(size)();
+        uint64_t print_ms = timeit("print              ",test_print,"p1.dat");
+        uint64_t each_ms = timeit("field by field     ",test_each,"p2.dat");
+        outs("speedup vs field by field")((double)each_ms/(print_ms ? print_ms : 1),"%.2f")("x")();
+        outs("speedup vs fprintf")((double)printf_ms/(print_ms ? print_ms : 1),"%.2f")("x")();
+        int res = system("cmp -s p1.dat p2.dat && cmp -s p1.dat p3.dat");
+        outs("same output")(res == 0 ? "yes" : "NO")();
+    }
+    remove("p1.dat");
+    remove("p2.dat");
+    remove("p3.dat");
+    return 0;
+}
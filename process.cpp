@@ -0,0 +1,269 @@
+// Lightweight operator() overloading stdio wrapper
+// running commands without blocking, with their output read line by line
+// Steve Donovan, (c) 2016
+// MIT license
+#include "process.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+
+extern char **environ;
+
+namespace stream {
+
+Process::Process(const std::string& cmd)
+  : child(0), fds{-1,-1}, exit_status(-1)
+{
+    spawn({"/bin/sh","-c",cmd});
+}
+
+Process::Process(const std::vector<std::string>& argv)
+  : child(0), fds{-1,-1}, exit_status(-1)
+{
+    spawn(argv);
+}
+
+Process::Process(Process&& p)
+  : child(p.child), fds{p.fds[0],p.fds[1]}, exit_status(p.exit_status),
+    err_msg(std::move(p.err_msg)), on_line(std::move(p.on_line))
+{
+    for (int which = 0; which < 2; ++which) {
+        partial[which] = std::move(p.partial[which]);
+        kept[which] = std::move(p.kept[which]);
+    }
+    p.child = 0;
+    p.fds[0] = p.fds[1] = -1;
+}
+
+Process& Process::operator= (Process&& p) {
+    if (this != &p) {
+        finish();
+        child = p.child;
+        fds[0] = p.fds[0];
+        fds[1] = p.fds[1];
+        exit_status = p.exit_status;
+        err_msg = std::move(p.err_msg);
+        on_line = std::move(p.on_line);
+        for (int which = 0; which < 2; ++which) {
+            partial[which] = std::move(p.partial[which]);
+            kept[which] = std::move(p.kept[which]);
+        }
+        p.child = 0;
+        p.fds[0] = p.fds[1] = -1;
+    }
+    return *this;
+}
+
+Process::~Process() {
+    finish();
+}
+
+// a child that is still running is killed, rather than waited for, since it
+// may never end; one that has exited is only reaped
+void Process::finish() {
+    close_fd(0);
+    close_fd(1);
+    if (running()) {
+        ::kill(child,SIGKILL);
+        reap();
+    }
+}
+
+bool Process::kill(int sig) {
+    return running() && ::kill(child,sig) == 0;
+}
+
+void Process::spawn(const std::vector<std::string>& argv) {
+    if (argv.empty()) {
+        err_msg = "no command";
+        return;
+    }
+    int out[2], err[2];
+    if (pipe2(out,O_CLOEXEC) == -1) {
+        err_msg = strerror(errno);
+        return;
+    }
+    if (pipe2(err,O_CLOEXEC) == -1) {
+        err_msg = strerror(errno);
+        ::close(out[0]);
+        ::close(out[1]);
+        return;
+    }
+    std::vector<char*> args;
+    for (const std::string& a : argv) {
+        args.push_back((char*)a.c_str());
+    }
+    args.push_back(nullptr);
+    // the copies made by dup2 don't keep O_CLOEXEC, the pipes themselves do
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions,out[1],1);
+    posix_spawn_file_actions_adddup2(&actions,err[1],2);
+    int res = posix_spawnp(&child,args[0],&actions,nullptr,args.data(),environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(out[1]);
+    ::close(err[1]);
+    if (res != 0) {
+        err_msg = strerror(res);
+        child = 0;
+        ::close(out[0]);
+        ::close(err[0]);
+        return;
+    }
+    fds[0] = out[0];
+    fds[1] = err[0];
+    for (int fd : fds) {
+        fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) | O_NONBLOCK);
+    }
+}
+
+Process& Process::lines(std::function<void(StrReader&,int)> fn) {
+    on_line = fn;
+    return *this;
+}
+
+bool Process::fail() {
+    return ! err_msg.empty();
+}
+
+std::string Process::error() {
+    return err_msg;
+}
+
+bool Process::running() {
+    return child != 0 && exit_status == -1;
+}
+
+// complete lines are passed on straight from the read buffer, unless they
+// began in an earlier read
+void Process::deliver(int which, const char *p, size_t n) {
+    if (! on_line) {
+        kept[which].append(p,n);
+        return;
+    }
+    std::string& part = partial[which];
+    const char *end = p + n;
+    while (p < end) {
+        const char *nl = (const char*)memchr(p,'\n',end - p);
+        if (nl == nullptr) {
+            part.append(p,end - p);
+            return;
+        }
+        const char *line = p;
+        size_t len = nl - p;
+        if (! part.empty()) {
+            part.append(p,len);
+            line = part.data();
+            len = part.size();
+        }
+        StrReader rdr(line,len);
+        on_line(rdr,which + 1);
+        part.clear();
+        p = nl + 1;
+    }
+}
+
+bool Process::read_ready(int which) {
+    char buff[65536];
+    ssize_t n = ::read(fds[which],buff,sizeof(buff));
+    if (n > 0) {
+        deliver(which,buff,n);
+        return true;
+    }
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+        return true;
+    }
+    // the last line needn't end with '\n'
+    std::string& part = partial[which];
+    if (! part.empty()) {
+        StrReader rdr(part.data(),part.size());
+        on_line(rdr,which + 1);
+        part.clear();
+    }
+    close_fd(which);
+    return false;
+}
+
+void Process::close_fd(int which) {
+    if (fds[which] != -1) {
+        ::close(fds[which]);
+        fds[which] = -1;
+    }
+}
+
+void Process::reap() {
+    int st;
+    while (waitpid(child,&st,0) == -1) {
+        if (errno != EINTR) {
+            exit_status = 127;
+            return;
+        }
+    }
+    exit_status = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + WTERMSIG(st);
+}
+
+int Process::wait() {
+    if (fds[0] != -1 || fds[1] != -1) {
+        ProcessGroup group;
+        group.add(*this).run();
+    } else if (running()) {
+        reap();
+    }
+    return exit_status;
+}
+
+ProcessGroup::ProcessGroup() : live(0) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+ProcessGroup::~ProcessGroup() {
+    ::close(epfd);
+}
+
+// each pipe is known by the index of its process, times two, plus which stream it is
+ProcessGroup& ProcessGroup::add(Process& p) {
+    bool open = false;
+    for (int which = 0; which < 2; ++which) {
+        if (p.fds[which] == -1) continue;
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = 2*procs.size() + which;
+        epoll_ctl(epfd,EPOLL_CTL_ADD,p.fds[which],&ev);
+        open = true;
+    }
+    procs.push_back(&p);
+    if (open) {
+        ++live;
+    } else if (p.running()) {
+        p.reap();
+    }
+    return *this;
+}
+
+// a closed pipe leaves the epoll set when it is closed
+size_t ProcessGroup::poll(int timeout_ms) {
+    if (live == 0) return 0;
+    epoll_event events[64];
+    int n = epoll_wait(epfd,events,64,timeout_ms);
+    for (int i = 0; i < n; ++i) {
+        Process *p = procs[events[i].data.u64 / 2];
+        int which = events[i].data.u64 % 2;
+        if (p->fds[which] == -1 || p->read_ready(which)) continue;
+        if (p->fds[0] == -1 && p->fds[1] == -1) {
+            p->reap();
+            --live;
+        }
+    }
+    return live;
+}
+
+void ProcessGroup::run() {
+    while (poll(-1) > 0) {
+    }
+}
+
+}
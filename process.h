@@ -0,0 +1,97 @@
+// Lightweight operator() overloading stdio wrapper
+// running commands without blocking, with their output read line by line
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_PROCESS_H
+#define __OUTSTREAM_PROCESS_H
+#include "instream.h"
+#include <functional>
+#include <sys/types.h>
+#include <signal.h>
+
+namespace stream {
+
+/// which of a process's output streams a line came from
+enum { proc_out = 1, proc_err = 2 };
+
+/// Process runs a command with `posix_spawn`, with its own pipes for stdout and
+/// stderr, so the two are kept apart. The command is run by the shell if given as
+/// a string, and directly if given as arguments. Output is read as it comes, by
+/// wait() or a ProcessGroup; each complete line is passed to lines(), as a StrReader
+/// over that line, or else kept, to be read with out() and err() afterwards.
+/// A process still running when its Process goes away is killed; wait() for it
+/// first if it should finish. It can be moved, but not while in a ProcessGroup.
+class Process {
+protected:
+    pid_t child;
+    int fds[2];
+    std::string partial[2];
+    std::string kept[2];
+    int exit_status;
+    std::string err_msg;
+    std::function<void(StrReader&,int)> on_line;
+
+    void spawn(const std::vector<std::string>& argv);
+    void deliver(int which, const char *p, size_t n);
+    void close_fd(int which);
+    void reap();
+    void finish();
+    friend class ProcessGroup;
+    /// read what's ready on one stream; false once it is closed
+    bool read_ready(int which);
+public:
+    explicit Process(const std::string& cmd);
+    explicit Process(const std::vector<std::string>& argv);
+    Process(Process&& p);
+    Process& operator= (Process&& p);
+    Process(const Process&) = delete;
+    Process& operator= (const Process&) = delete;
+    ~Process();
+
+    /// `fn(line,stream)` gets each line, without its '\n'; `stream` is proc_out or
+    /// proc_err. The line is only good for the duration of the call
+    Process& lines(std::function<void(StrReader&,int)> fn);
+
+    /// true if the command couldn't be started
+    bool fail();
+    operator bool () { return ! fail(); }
+    std::string error();
+
+    pid_t pid() { return child; }
+    bool running();
+    /// read all the output and wait for the process to finish
+    int wait();
+    /// send it a signal, SIGTERM by default; false if it isn't running
+    bool kill(int sig=SIGTERM);
+    /// the exit code, or 128 plus the signal if it was killed, as the shell reports
+    /// it; -1 if still running or never started
+    int status() { return exit_status; }
+
+    /// the output when there is no lines() function
+    const std::string& out() { return kept[0]; }
+    const std::string& err() { return kept[1]; }
+};
+
+/// ProcessGroup drives the output of many processes from one thread with `epoll`,
+/// so that none of them waits on another.
+class ProcessGroup {
+    int epfd;
+    std::vector<Process*> procs;
+    size_t live;
+public:
+    ProcessGroup();
+    ~ProcessGroup();
+
+    /// the process must outlive the group, or at least until it has finished
+    ProcessGroup& add(Process& p);
+    /// handle whatever output is ready, waiting up to `timeout_ms` for some (-1
+    /// for as long as it takes); returns the number of processes still running
+    size_t poll(int timeout_ms=-1);
+    /// until all have finished
+    void run();
+    size_t running() { return live; }
+};
+
+}
+#endif
@@ -0,0 +1,286 @@
+// reading numbers back: the read-side counterpart of speedtest
+#include "instream.h"
+#include "outstream.h"
+#include "compress.h"
+#include <fstream>
+#include <string.h>
+#include <time.h>
+using namespace std;
+using namespace stream;
+
+static uint64_t millisecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    return 1000L*ts.tv_sec + ts.tv_nsec/1000000L;
+}
+
+const auto N = 1000000;
+const char *file = "r.dat";
+
+typedef uint64_t U64;
+
+// the sums make sure that every method read the same values
+double sum;
+
+void make_file() {
+    Writer w(file);
+    w.sep(' ');
+    for (int i = 0; i < N; i++) {
+        w(i)(i*0.25)("row")(1000.0/(i+1))(i*3)();
+    }
+}
+
+void testread_f() {
+    FILE *in = fopen(file,"r");
+    int64_t i, j;
+    double x, y;
+    char s[64];
+    while (fscanf(in,"%" SCNd64 " %lf %63s %lf %" SCNd64,&i,&x,s,&y,&j) == 5) {
+        sum += i + x + y + j;
+    }
+    fclose(in);
+}
+
+// explicit formats are still handed to scanf, which is how every field used to be read
+void testread_scanf() {
+    Reader rdr(file);
+    int64_t i, j;
+    double x, y;
+    string s;
+    const char *ifmt = "%" SCNd64 "%n", *dfmt = "%lf%n";
+    while (rdr(i,ifmt)(x,dfmt)(s)(y,dfmt)(j,ifmt)) {
+        sum += i + x + y + j;
+    }
+}
+
+void testread_s() {
+    Reader rdr(file);
+    int64_t i, j;
+    double x, y;
+    string s;
+    while (rdr(i)(x)(s)(y)(j)) {
+        sum += i + x + y + j;
+    }
+}
+
+void testread_m() {
+    MmapReader rdr(file);
+    int64_t i, j;
+    double x, y;
+    string_view s;
+    while (rdr(i)(x)(s)(y)(j)) {
+        sum += i + x + y + j;
+    }
+}
+
+void testread_i() {
+    ifstream in(file);
+    int64_t i, j;
+    double x, y;
+    string s;
+    while (in >> i >> x >> s >> y >> j) {
+        sum += i + x + y + j;
+    }
+}
+
+// lines from 10 to 10,000 characters long
+const int NL = 200000;
+const char *lines_file = "l.dat";
+
+void make_lines() {
+    Writer w(lines_file);
+    string line;
+    for (int i = 0; i < NL; i++) {
+        line.assign(10 + (i*7919) % (i % 100 ? 1000 : 10000),'x');
+        w(line)();
+    }
+}
+
+// the old getline: 256-byte fgets chunks appended to the string
+void testlines_chunks() {
+    FILE *in = fopen(lines_file,"r");
+    char buff[256];
+    string s;
+    bool more = true;
+    while (more) {
+        s.clear();
+        more = false;
+        while (fgets(buff,sizeof(buff),in)) {
+            size_t n = strlen(buff);
+            more = true;
+            if (buff[n-1] == '\n') {
+                s.append(buff,n-1);
+                break;
+            }
+            s.append(buff,n);
+        }
+        sum += s.size();
+    }
+    fclose(in);
+}
+
+void testlines_s() {
+    Reader rdr(lines_file);
+    string s;
+    while (rdr.getline(s)) {
+        sum += s.size();
+    }
+}
+
+void testlines_i() {
+    ifstream in(lines_file);
+    string s;
+    while (std::getline(in,s)) {
+        sum += s.size();
+    }
+}
+
+// line info from all over the file: the first call indexes the file, and the
+// rest are binary searches, where each used to read the file from the start
+void testlineinfo() {
+    Reader rdr(lines_file);
+    rdr.setpos(0,'$');
+    long size = rdr.getpos();
+    rdr.setpos(0);
+    for (int k = 0; k < 1000; k++) {
+        sum += rdr.getlineinfo(size/1000*k).line;
+    }
+}
+
+// binary records, one read<T> at a time against read_records in bulk
+struct Record {
+    int64_t id;
+    double value;
+    int32_t count;
+    float weight;
+};
+const size_t R = 4000000;
+const char *records_file = "b.dat";
+
+void make_records() {
+    vector<Record> recs(R);
+    for (size_t i = 0; i < R; i++) {
+        recs[i] = Record{(int64_t)i,i*0.5,(int32_t)(i%1000),1.0f};
+    }
+    Writer w(records_file,"wb");
+    w.writebehind().write_records(recs);
+}
+
+void testrecords_each() {
+    Reader rdr(records_file,"rb");
+    Record r;
+    while (rdr.read(r)) {
+        sum += r.id + r.count;
+    }
+}
+
+void testrecords_bulk() {
+    Reader rdr(records_file,"rb");
+    vector<Record> recs;
+    rdr.readahead().read_records(recs);
+    for (const Record& r : recs) {
+        sum += r.id + r.count;
+    }
+}
+
+void testrecords_swapped() {
+    Reader rdr(records_file,"rb");
+    vector<int64_t> words;
+    rdr.readahead().read_records<big_endian>(words);
+    for (int64_t w : words) {
+        sum += w & 1;
+    }
+}
+
+U64 timeit(const char *name, void (*test)()) {
+    sum = 0;
+    U64 start = millisecs();
+    test();
+    U64 diff = millisecs() - start;
+    outs(name)(diff)("ms")("sum")(sum,"%.17g")();
+    return diff;
+}
+
+// the numbers file compressed as it is written, against writing it and
+// then compressing it in a separate pass
+const char *gz_file = "r.dat.gz";
+
+void make_gz_each(bool together) {
+    if (together) {
+        ZWriter w(gz_file,compress_gzip,1);
+        w.sep(' ');
+        for (int i = 0; i < N; i++) {
+            w(i)(i*0.25)("row")(1000.0/(i+1))(i*3)();
+        }
+    } else {
+        make_file();
+        CmdReader(string("gzip -1 -c ") + file + " > " + gz_file).line();
+    }
+}
+
+void make_gz_together() { make_gz_each(true); }
+void make_gz_separate() { make_gz_each(false); }
+
+void testread_gz(Reader& rdr) {
+    int i,k;
+    double x,y;
+    string r;
+    while (rdr(i)(x)(r)(y)(k)) {
+        sum += x + y;
+    }
+}
+
+void testread_z() {
+    ZReader rdr(gz_file);
+    testread_gz(rdr);
+}
+
+void testread_zcat() {
+    CmdReader rdr(string("zcat ") + gz_file);
+    testread_gz(rdr);
+}
+
+void speedup(const char *name, U64 baseline, U64 ms) {
+    outs("speedup vs")(name)((double)baseline/(ms ? ms : 1),"%.2f")("x")();
+}
+
+int main(int argc, char **argv)
+{
+    make_file();
+    U64 stdio_ms = timeit("fscanf      ",testread_f);
+    U64 scanf_ms = timeit("scanf fields",testread_scanf);
+    U64 ins_ms = timeit("instreams   ",testread_s);
+    U64 mmap_ms = timeit("mmap        ",testread_m);
+    U64 io_ms = timeit("iostreams   ",testread_i);
+    speedup("fscanf",stdio_ms,ins_ms);
+    speedup("scanf fields",scanf_ms,ins_ms);
+    speedup("iostreams",io_ms,ins_ms);
+    outs("mmap");
+    speedup("fscanf",stdio_ms,mmap_ms);
+
+    make_lines();
+    U64 chunks_ms = timeit("256-byte fgets chunks",testlines_chunks);
+    U64 lines_ms = timeit("instreams getline    ",testlines_s);
+    U64 iolines_ms = timeit("std::getline         ",testlines_i);
+    speedup("fgets chunks",chunks_ms,lines_ms);
+    speedup("std::getline",iolines_ms,lines_ms);
+    timeit("getlineinfo x 1000     ",testlineinfo);
+
+    make_records();
+    U64 each_ms = timeit("read<T> per record    ",testrecords_each);
+    U64 bulk_ms = timeit("read_records          ",testrecords_bulk);
+    timeit("read_records swapped  ",testrecords_swapped);
+    speedup("read<T>",each_ms,bulk_ms);
+
+    U64 sep_ms = timeit("write, then gzip -1   ",make_gz_separate);
+    U64 gz_ms = timeit("ZWriter gzip level 1  ",make_gz_together);
+    speedup("a separate pass",sep_ms,gz_ms);
+    U64 zcat_ms = timeit("CmdReader zcat        ",testread_zcat);
+    U64 zr_ms = timeit("ZReader               ",testread_z);
+    speedup("zcat",zcat_ms,zr_ms);
+    remove(gz_file);
+    remove(file);
+    remove(lines_file);
+    remove(records_file);
+    return 0;
+}
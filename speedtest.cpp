@@ -1,5 +1,9 @@
 #include "outstream.h"
+#include "json.h"
+#include "fdwriter.h"
+#include "basicwriter.h"
 #include <fstream>
+#include <vector>
 #include <time.h>
 using namespace std;
 using namespace stream;
@@ -22,6 +26,14 @@ void testwrite_s(string file) {
     }
 }
 
+void testwrite_c(string file) {
+    Writer w(file.c_str());
+
+    for (int i = 0; i < N; i++) {
+        w.fmt<"%g %g %g %g %g\n">(x1,x2,x3,x4,x5);
+    }
+}
+
 void testwrite_f(string file) {
     FILE *out = fopen(file.c_str(),"w");
 
@@ -46,21 +58,210 @@ typedef uint64_t U64;
 
 int exec(const char *cmd) { return system(cmd); }
 
-int main(int argc, char **argv)
-{
+// write(2) calls made so far by this process
+static U64 write_syscalls() {
+    U64 n = 0;
+    FILE *io = fopen("/proc/self/io","r");
+    if (io == nullptr) return 0;
+    char line[64];
+    while (fgets(line,sizeof(line),io)) {
+        if (sscanf(line,"syscw: %" SCNu64,&n) == 1) break;
+    }
+    fclose(io);
+    return n;
+}
+
+// an unbuffered stream that counts how often stdio is asked to write
+static U64 stdio_calls;
+
+static ssize_t count_write(void *, const char *, size_t n) {
+    ++stdio_calls;
+    return n;
+}
+
+FILE *counting_stream() {
+    cookie_io_functions_t io = {nullptr, count_write, nullptr, nullptr};
+    FILE *f = fopencookie(nullptr,"w",io);
+    setvbuf(f,nullptr,_IONBF,0);
+    return f;
+}
+
+void write_rows(Writer& w, int rows) {
+    w.sep(' ');
+    for (int i = 0; i < rows; i++) {
+        w(i)(x1)("row")(x2)(i*3)();
+    }
+}
+
+// the same 5-field rows, unbuffered (every field and separator is a stdio call)
+// and then formatted into the Writer's own buffer
+void testrows(size_t bufsize, const char *name) {
+    const int rows = 2*N;
+    Writer w("rows.dat");
+    w.buffering(bufsize);
+    U64 sys = write_syscalls();
     U64 start = millisecs();
-    testwrite_f("f.dat");
+    write_rows(w,rows);
+    w.flush();
     U64 diff = millisecs() - start;
-    U64 stdio_ms = diff;
-    outs("stdio ")(diff)("ms")();
+    sys = write_syscalls() - sys;
+
+    stdio_calls = 0;
+    Writer counted(counting_stream());
+    counted.buffering(bufsize);
+    write_rows(counted,rows);
+    counted.flush();
+    fclose(counted.stream());
+
+    outs(name)(diff)("ms")((double)sys/rows,"%.4f")("syscalls/row")
+        ((double)stdio_calls/rows,"%.4f")("stdio calls/row")();
+}
+
+// 10M-element vectors written with range(), against one element at a time
+const size_t V = 10000000;
+
+template <class T>
+void write_vector(const char *name, const vector<T>& v, const char *fmt, char sepr) {
+    U64 start = millisecs();
+    {
+        Writer w("v.dat");
+        w(range(v),fmt,sepr)();
+    }
+    U64 range_ms = millisecs() - start;
+    FILE *f = fopen("v.dat","r");
+    fseek(f,0,SEEK_END);
+    double mb = ftell(f)/1e6;
+    fclose(f);
     start = millisecs();
-    testwrite_s("s.dat");
-    diff = millisecs() - start;
-    outs("outstreams ")(diff)("ms")();
+    {
+        Writer w("v.dat");
+        w.sep(sepr);
+        for (const T& x : v) {
+            w(x,fmt);
+        }
+        w();
+    }
+    U64 each_ms = millisecs() - start;
+    outs(name)("range")(range_ms,"%5d")("ms")(mb/(range_ms ? range_ms : 1)*1000,"%6.0f")("MB/s")
+        ("each")(each_ms,"%5d")("ms")("speedup")((double)each_ms/(range_ms ? range_ms : 1),"%.2f")();
+}
+
+void test_vectors() {
+    vector<double> xs(V);
+    vector<int> is(V);
+    vector<unsigned char> bytes(V);
+    for (size_t i = 0; i < V; i++) {
+        xs[i] = i*0.25;
+        is[i] = (int)(i*2654435761u);
+        bytes[i] = (unsigned char)(i*131 + (i >> 8));
+    }
+    write_vector("double      ",xs,nullptr,' ');
+    write_vector("int         ",is,nullptr,' ');
+    write_vector("int hex     ",is,hex_u,',');
+    write_vector("bytes hex   ",bytes,hex_u,' ');
+    write_vector("bytes dump  ",bytes,hex_bytes_u,0);
+}
+
+// 1M records as compact JSON, with strings that mostly need no escaping
+void test_json() {
+    U64 start = millisecs();
+    {
+        Writer w("j.dat");
+        w.buffering(65536);
+        JsonWriter js(w);
+        string name = "a record name long enough to be worth scanning";
+        string quoted = "with \"quotes\" and a\ttab";
+        for (int i = 0; i < 1000000; i++) {
+            js.object()("id",i)("name",name)("note",quoted)("x",i*0.5)
+                .array("v")(i)(i+1)(i+2).end()
+            .end();
+        }
+    }
+    U64 ms = millisecs() - start;
+    FILE *f = fopen("j.dat","r");
+    fseek(f,0,SEEK_END);
+    double mb = ftell(f)/1e6;
+    fclose(f);
+    outs("json records")(ms,"%5d")("ms")(mb/(ms ? ms : 1)*1000,"%6.0f")("MB/s")();
+}
+
+// the usual five doubles a line, through a Writer and then through the BasicWriter
+// with the matching sink; `each_line` is called after every line
+template <class W, class B, class F, class G>
+void sink_rows(const char *name, W& w, B& b, F each_line, G each_basic) {
+    w.sep(' ');
+    b.sep(' ');
+    U64 start = millisecs();
+    for (int i = 0; i < N; i++) {
+        w(x1)(x2)(x3)(x4)(x5)();
+        each_line();
+    }
+    w.flush();
+    U64 virt_ms = millisecs() - start;
     start = millisecs();
-    testwrite_i("io.dat");
-    diff = millisecs() - start;
-    outs("iostreams ")(diff)("ms")();
-    exec("rm f.dat s.dat io.dat");
+    for (int i = 0; i < N; i++) {
+        b(x1)(x2)(x3)(x4)(x5)();
+        each_basic();
+    }
+    b.flush();
+    U64 basic_ms = millisecs() - start;
+    outs(name)("Writer")(virt_ms,"%4d")("ms")("BasicWriter")(basic_ms,"%4d")("ms")
+        ("speedup")((double)virt_ms/(basic_ms ? basic_ms : 1),"%.2f")();
+}
+
+void test_sinks() {
+    auto nothing = []{};
+    {
+        Writer w("f.dat");
+        BasicWriter<FileSink> b("f.dat");
+        sink_rows("file   ",w,b,nothing,nothing);
+    }
+    {
+        FdWriter w("f.dat");
+        BasicWriter<FdSink> b("f.dat");
+        sink_rows("fd     ",w,b,nothing,nothing);
+    }
+    {
+        StrWriter w;
+        BasicWriter<StrSink> b;
+        sink_rows("string ",w,b,nothing,nothing);
+    }
+    {
+        char buf1[128], buf2[128];
+        BufWriter w(buf1,sizeof(buf1));
+        BasicWriter<BufSink> b(buf2,sizeof(buf2));
+        sink_rows("buffer ",w,b,[&]{ w.reset(); },[&]{ b.sink().reset(); });
+    }
+}
+
+U64 timeit(const char *name, void (*test)(string), string file) {
+    U64 start = millisecs();
+    test(file);
+    U64 diff = millisecs() - start;
+    outs(name)(diff)("ms")();
+    return diff;
+}
+
+// how many times faster outstreams is than a baseline
+void speedup(const char *name, U64 baseline, U64 ms) {
+    outs("speedup vs")(name)((double)baseline/(ms ? ms : 1),"%.2f")("x")();
+}
+
+int main(int argc, char **argv)
+{
+    U64 stdio_ms = timeit("stdio ",testwrite_f,"f.dat");
+    U64 outs_ms = timeit("outstreams ",testwrite_s,"s.dat");
+    U64 cfmt_ms = timeit("compiled fmt ",testwrite_c,"c.dat");
+    U64 io_ms = timeit("iostreams ",testwrite_i,"io.dat");
+    speedup("stdio",stdio_ms,outs_ms);
+    speedup("iostreams",io_ms,outs_ms);
+    outs("compiled fmt");
+    speedup("stdio",stdio_ms,cfmt_ms);
+    testrows(0,"unbuffered rows");
+    testrows(65536,"buffered rows");
+    test_vectors();
+    test_json();
+    test_sinks();
+    exec("rm f.dat s.dat c.dat io.dat rows.dat v.dat j.dat");
     return 0;
 }
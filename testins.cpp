@@ -1,6 +1,14 @@
 #include "instream.h"
 #include "outstream.h"
+#include "arena.h"
+#include "parallel.h"
+#include "process.h"
+#include "compress.h"
 #include <vector>
+#include <string_view>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
 using namespace std;
 using namespace stream;
 
@@ -11,6 +19,7 @@ int main(int argc, char **argv)
     int res = 0, N = 0;
     string s1,s2,s3;
     vector<string> lines;
+    string_view w1, w2;
     Reader::Error err;
     char ch = 'X';
 
@@ -61,6 +70,221 @@ int main(int argc, char **argv)
     }
     outs(i)(s1)(s2)(res)(ch)(eol);
 
+    outs("+++string readers own or view their text")();
+    StrReader tmp(string("10 20\nlast line"));
+    tmp(i)(res);
+    string_view rest;
+    tmp.skip().getline(rest);
+    outs(i)(res)(rest,quote_s)(eol);
+    string_view part = "7 eight 9.5 tail";
+    StrReader sv8(part.substr(0,11));
+    sv8(i)(w1)(x)(s1)(err);
+    outs(i)(w1)(x)(err.msg)(eol);
+
+    outs("+++lines and words kept in an arena")();
+    Arena arena;
+    vector<string_view> views;
+    Reader("input-test.txt").use(arena).getlines<string_view>(views);
+    for (string_view v : views) outs(v,quote_s)(eol);
+    StrReader("alpha beta").use(arena)(w1)(w2);
+    outs(w1)(w2)(arena.used())(eol);
+    StrWriter sw;
+    sw("one")(2)("three");
+    string_view taken = sw.take(arena);
+    outs(taken,quote_s)(sw.text().size())(eol);
+    arena.reset();
+    outs("after reset")(arena.used())(eol);
+
+    outs("+++memory-mapped file")();
+    MmapReader mr("input-test.txt");
+    mr(i)(x)(s1);
+    outs(i)(x)(s1,quote_s)(eol);
+    mr(i)(s1)(s2)()(res)(err);
+    if (err) {
+        outs("failed")(err.errcode)(err.msg)(eol);
+    }
+    MmapReader mr2("input-test.txt");
+    views.clear();
+    mr2.skip(1).getlines<string_view>(views);
+    for (string_view v : views) outs(v,quote_s)(eol);
+    outs(mr2.error())(eol);
+    MmapReader mr3("input-test.txt");
+    long p = contents.find("token");
+    Reader::LineInfo li = mr3.getlineinfo(p);
+    mr3.setpos(p);
+    mr3(w1)(w2)(s3);
+    outs("line")(li.line)("column")(li.column)(w1)(w2)(s3)(eol);
+    mr3.setpos(-2,'$');
+    mr3(ch)(w1)(err);
+    outs(ch)(err.msg)(eol);
+
+    outs("+++extra separators")();
+    int64_t k;
+    StrReader("1,2.5,  |abc| ,4").separators(",|")(i)(x)(s1)(k);
+    outs(i)(x)(s1,quote_s)(k)(eol);
+    {
+        // words and numbers from a file are scanned in stdio's buffer, across refills
+        Writer w("words.tmp");
+        for (int r = 0; r < 20000; r++) w.fmt("w%d, %d,|\n",r,r*3);
+    }
+    Reader fr("words.tmp");
+    fr.separators(",|");
+    long wsum = 0;
+    int wrows = 0;
+    while (fr(s1)(k)) {
+        if (s1 == "w" + to_string(wrows) && k == wrows*3) ++wrows;
+        wsum += k;
+    }
+    outs(wrows)(wsum)(fr.error())(eol);
+    remove("words.tmp");
+    vector<FieldPos> fields;
+    string row = "  one,two  three,,four ";
+    split_fields(row.data(),row.data()+row.size(),Delims(","),fields);
+    for (FieldPos f : fields) outs(row.substr(f.start,f.len),quote_s)(f.start);
+    outs(eol);
+
+    outs("+++CSV records")();
+    CsvReader csv("input-test.csv");
+    vector<string> header;
+    csv.row(header);
+    outs(range(header),quote_s)(eol);
+    while (csv(i)(s1)(x)(s2)) {
+        outs(i)(s1,quote_s)(x)(s2,quote_s)(csv.fields())(eol);
+        if (i == 3) p = csv.getpos();
+    }
+    outs(csv.error())(eol);
+    FILE *semi = fmemopen((void*)"a;1\nb;x\n",8,"r");
+    CsvReader sv(semi,';');
+    sv(s1)(i)(s2)(i)(err);
+    outs(s1)(i)(s2)(err.msg)("at")(err.pos)(eol);
+    li = csv.getlineinfo(p);
+    outs("record 4 at line")(li.line)("column")(li.column)(eol);
+    fclose(semi);
+    // a stray quote is only text, so it doesn't carry the record over the newline
+    const char *stray = "a,b\"c,d\n\"x\"y\"z,\"\"\"q\"\n1,2,3\n";
+    FILE *sf = fmemopen((void*)stray,strlen(stray),"r");
+    CsvReader sc2(sf);
+    vector<string> srow;
+    while (sc2.row(srow)) {
+        outs(range(srow),quote_s)(eol);
+    }
+    fclose(sf);
+    // getline after a field has the record as it was in the file
+    const char *quoted = "\"a,b\",c\nx,y\n";
+    FILE *qf = fmemopen((void*)quoted,strlen(quoted),"r");
+    CsvReader qc(qf);
+    qc(s1).getline(s2);
+    outs(s1,quote_s)(s2,quote_s);
+    qc.getline(s2);
+    outs(s2,quote_s)(eol);
+    fclose(qf);
+
+    outs("+++line index")();
+    Reader lx("input-test.txt");
+    li = lx.getlineinfo(contents.find("token"));
+    outs("line")(li.line)("column")(li.column)(eol);
+    lx.seek_line(3).getline(s3);
+    outs(s3,quote_s)(lx.getpos())(eol);
+    outs("saved")(lx.save_index("input-test.idx"))(eol);
+    Reader ly("input-test.txt");
+    outs("loaded")(ly.load_index("input-test.idx"));
+    ly.seek_line(4).getline(s3);
+    outs(s3,quote_s)(eol);
+    ly.seek_line(9)(err);
+    outs(err.msg)(eol);
+    {
+        // the same size, and likely the same second, but a new file
+        Writer("lines.tmp").raw("a\nbb\nc\n",7);
+        Reader li1("lines.tmp");
+        li1.save_index("lines.idx");
+        Writer("lines2.tmp").raw("aa\nb\nc\n",7);
+        rename("lines2.tmp","lines.tmp");
+        Reader li2("lines.tmp");
+        outs("replaced")(li2.load_index("lines.idx"));
+        li2.seek_line(2).getline(s3);
+        outs(s3,quote_s)(eol);
+        remove("lines.tmp");
+        remove("lines.idx");
+    }
+    StrReader lm(contents);
+    outs("in memory")(lm.save_index("input-test.idx"))(lm.load_index("input-test.idx"))(eol);
+    remove("input-test.idx");
+    StrReader lz("one\ntwo\nthree");
+    lz.index_lines().skip(2);
+    li = lz.getlineinfo(10);
+    outs("line")(li.line)("column")(li.column)(eol);
+
+    outs("+++parallel chunks")();
+    {
+        Writer w("par.tmp");
+        w.sep(' ');
+        for (int r = 0; r < 20000; r++) {
+            if (r == 15000) w("oops")(r)(); else w(r)(r*0.5)();
+        }
+    }
+    ParallelReader par("par.tmp",4,4096);
+    vector<int> firsts;
+    par.collect(firsts,[](MmapReader& rdr, vector<int>& part) {
+        int a;
+        double b;
+        while (rdr(a)(b)) part.push_back(a);
+    });
+    outs(par.chunks() > 1)(firsts.size())(is_sorted(firsts.begin(),firsts.end()))(eol);
+    par(err);
+    li = par.getlineinfo(err.pos);
+    outs(err.msg)("at")(err.pos)("line")(li.line)("column")(li.column)(eol);
+    atomic<long> total(0);
+    par.each([&](MmapReader& rdr) {
+        long sum = 0;
+        int a;
+        double b;
+        while (rdr(a)(b)) sum += a;
+        total += sum;
+    });
+    vector<string_view> plines;
+    par.getlines<string_view>(plines);
+    outs(total.load())(plines.size())(plines[15000],quote_s)(eol);
+    // a throw from deliver leaves the workers joined, and the reader can be used again
+    size_t delivered = 0;
+    try {
+        par.in_order<int>([](MmapReader& rdr, int& n) {
+            string line;
+            while (rdr.getline(line)) ++n;
+        },[&](int&) {
+            if (++delivered == 2) throw runtime_error("enough");
+        });
+    } catch (const runtime_error& e) {
+        outs(e.what())(delivered)(eol);
+    }
+    firsts.clear();
+    par.collect(firsts,[](MmapReader& rdr, vector<int>& part) {
+        int a;
+        double b;
+        while (rdr(a)(b)) part.push_back(a);
+    });
+    outs(firsts.size())(eol);
+    // and so does a throw from parse, on a worker thread, in order or not
+    try {
+        par.collect(firsts,[](MmapReader& rdr, vector<int>& part) {
+            int a;
+            double b;
+            while (rdr(a)(b)) {
+                if (a == 12345) throw runtime_error("bad row");
+                part.push_back(a);
+            }
+        });
+    } catch (const runtime_error& e) {
+        outs(e.what());
+    }
+    try {
+        par.each([](MmapReader&) {
+            throw runtime_error("bad chunk");
+        });
+    } catch (const runtime_error& e) {
+        outs(e.what())(eol);
+    }
+    remove("par.tmp");
+
     outs("+++all header files in this directory")();
     lines.clear();
     CmdReader("ls *.h").getlines(lines);
@@ -90,6 +314,110 @@ int main(int argc, char **argv)
     CmdReader("false",cmd_retcode) (retcode);
     outs("actual retcode")(retcode)(eol);
 
+    outs("+++processes with separate output")();
+    vector<string> outl, errl;
+    Process pr("echo one 1; echo oops >&2; echo two 2; printf last; exit 3");
+    pr.lines([&](StrReader& line, int stream) {
+        string w;
+        int n = 0;
+        line(w)(n);
+        (stream == proc_out ? outl : errl).push_back(w + "=" + to_string(n));
+    });
+    outs("status")(pr.wait())(range(outl))("stderr")(range(errl))(eol);
+    vector<Process*> procs;
+    ProcessGroup group;
+    for (int c = 1; c <= 3; c++) {
+        procs.push_back(new Process(vector<string>{"seq",to_string(c*1000)}));
+        group.add(*procs.back());
+    }
+    Process killed("kill -9 $$");
+    group.add(killed).run();
+    for (Process *q : procs) {
+        StrReader sq(q->out());
+        vector<string> nums;
+        sq.getlines(nums);
+        outs(q->status())(nums.size())(nums.back());
+        delete q;
+    }
+    outs("killed")(killed.status())(eol);
+    Process missing(vector<string>{"no-such-command"});
+    outs(missing.fail())(missing.error())(missing.wait())(eol);
+    Process sleeper("exec sleep 100");
+    Process moved(std::move(sleeper));
+    outs("moved")(sleeper.running())(moved.running())(moved.kill())(moved.wait())(eol);
+    {
+        Process forgotten("exec sleep 100");
+    }
+    outs("not waited for")(eol);
+
+    outs("+++inf and nan stop where scanf stops")();
+    for (const char *t : {"nan(abc)","nan(a b)","nan(a-b)","nan(","NAN(9)","inf(x)","infinity(x)"}) {
+        double d;
+        int n = -1;
+        sscanf(t,"%lf%n",&d,&n);
+        StrReader sr(t);
+        sr(d);
+        FILE *mf = fmemopen((void*)t,strlen(t),"r");
+        Reader fr(mf);
+        fr(d);
+        outs(t,quote_d)(n)(sr.getpos())(fr.getpos())(eol);
+        fclose(mf);
+    }
+
+    outs("+++compressed files")();
+    {
+        ZWriter zw("test.tmp.gz",compress_by_name,9);
+        zw.sep(' ');
+        for (int i = 0; i < 200000; i++) {
+            zw(i)(i*0.5)("row")();
+        }
+    }
+    {
+        // appending adds another gzip member, which is read straight on
+        ZWriter zw("test.tmp.gz",compress_gzip,1,"a");
+        zw("appended")();
+    }
+    ZReader zr("test.tmp.gz");
+    int zrows = 0;
+    double zsum = 0;
+    string zline, zlast;
+    while (zr.getline(zline)) {
+        zlast = zline;
+        StrReader zs(zline);
+        int i;
+        double x;
+        if (zs(i)(x)) {
+            zsum += x;
+            ++zrows;
+        }
+    }
+    outs(zrows)(zsum)(zlast)(eol);
+    outs("zcat agrees")(CmdReader("zcat test.tmp.gz | wc -l").line())(eol);
+    {
+        // a cut-off file gives all the lines before the cut, and then the error
+        vector<char> gz;
+        Reader("test.tmp.gz").read_records(gz);
+        Writer("test.tmp2.gz").write(gz.data(),gz.size()/2);
+    }
+    ZReader cut("test.tmp2.gz");
+    int cut_rows = 0;
+    while (cut.getline(zline)) {
+        StrReader zs(zline);
+        int i;
+        double x;
+        if (zs(i)(x) && i == cut_rows && x == i*0.5) ++cut_rows;
+    }
+    int zcat_rows = stoi(CmdReader("zcat test.tmp2.gz 2>/dev/null | wc -l").line());
+    outs("cut short")(cut_rows == zcat_rows)(cut.fail())(cut.error())(eol);
+    remove("test.tmp2.gz");
+    ZReader plain("input-test.txt");
+    plain.getline(zline);
+    outs("not compressed")(zline,quote_d)(eol);
+    ZReader bad_gz("input-test.txt",compress_gzip);
+    bad_gz.getline(zline);
+    outs("not gzip")(bad_gz.fail())(bad_gz.error())(eol);
+    remove("test.tmp.gz");
+
     /*
 
    s = "one two   30";
@@ -1,5 +1,9 @@
 #include "outstream.h"
+#include "fdwriter.h"
+#include "json.h"
+#include "basicwriter.h"
 #include <vector>
+#include <algorithm>
 using namespace std;
 using namespace stream;
 
@@ -14,6 +18,61 @@ public:
     }
 };
 
+// a Writeable that writes separate fields
+class Fields: public Writeable {
+public:
+    virtual void write_to(Writer& out, const char *) const {
+        out(1)(2);
+    }
+};
+
+// a type with its own JSON structure
+class Segment: public JsonWriteable {
+    Point A, B;
+public:
+    Segment(Point A, Point B) : A(A), B(B) { }
+
+    virtual void write_json(JsonWriter& js) const {
+        js.object()("from",A)("to",B).end();
+    }
+};
+
+static void count_spill(void *data, const char *s, size_t n) {
+    *(size_t*)data += n;
+}
+
+void fixed_buffers() {
+    outs("*fixed buffers")();
+    char small[16];
+    BufWriter bw(small,sizeof(small),' ');
+    bw("hello")("world")(42)(3.14159).flush();
+    outs(small,quote_d)(bw.truncated())(bw.needed())(bw ? "ok" : "full")();
+
+    // reused, this time formatting more than fits
+    bw.reset();
+    bw.fmt("%s-%s-%s-%d","one","two","three",12345).flush();
+    outs(small,quote_d)(bw.truncated())(bw.needed())(bw.needed() == 19)();
+    // and after a field, so the format starts part way in
+    bw.reset();
+    bw("start").fmt("<%08d|%s>",42,"tail").flush();
+    outs(small,quote_d)(bw.truncated())(bw.needed())(bw ? "ok" : "full")();
+
+    // spilling the buffer into a string whenever it fills
+    string all;
+    bw.reset().spill(all);
+    bw("hello")("world")(42)(3.14159)(string(20,'x'),"<%s>").flush();
+    outs(all,quote_d)(bw.truncated())(bw.needed())(all.size())();
+
+    // or to a callback
+    size_t spilled = 0;
+    bw.reset().spill(count_spill,&spilled);
+    for (int i = 0; i < 100; i++) {
+        bw(i);
+    }
+    bw.flush();
+    outs("spilled")(spilled)(bw.needed())();
+}
+
  void custom_type_point() {
     outs("*custom Point output")();
     Point P(10,100);
@@ -34,10 +93,31 @@ void writing_iterator_range() {
     // can specify the FORMAT and the SEPARATOR for a range
     string s = "\xFE\xEE\xAA";
     outs(range(s),"X",0)("and that's all")();
+    // two digits for each byte make a hex dump; a newline byte is just 0A
+    vector<unsigned char> bytes {0x00,0x0A,0x7F,0xC3,0x10,0x01,0xFF,0x2B,0x3C,0x4D,0x5E,0x6F,0x70,0x81,0x92,0xA3,0xB4,0x05};
+    outs(range(bytes),hex_bytes_u,0)();
+    outs(range(bytes),hex_bytes_l,':')();
+    string ctrl = "\n\t";
+    outs(range(ctrl),hex_u)(-5,hex_bytes_u)(10,hex_bytes_l)();
+    // formats without a fast path get the same two digits
+    char spec1[30], spec2[30];
+    outs(field_format("%" PRIi32,hex_bytes_u,spec1))(field_format("%c",hex_bytes_l,spec2))();
 
 
     outs("bork")(range(vi),"%#X",',')("heh")();
 
+    // copies write through the original, so their text stays in order
+    outs("before");
+    for_each(vi.begin(),vi.begin() + 3,outs);
+    outs("after")();
+    Writer(outs,',')("x")(1)(2)();
+    Writer copy(outs);
+    copy("prompt:");
+    fprintf(copy.stream()," [printf] ");
+    outs("original");
+    copy("copy");
+    outs();
+
     // write out a quick little burst of json
     // The hex_u format (double-quoted) only applies to text fields
     // so can be safely passed for all times. q means single-quoted
@@ -56,12 +136,72 @@ int writing_to_file() {
     return system("cat test.txt");
 }
 
+void writing_to_fd() {
+    outs("*writing to a file descriptor")();
+    {
+        FdWriter fw("test-fd.txt");
+        fw.sep(',');
+        fw(1)(2.5)("three")();
+        long p = fw.getpos();
+        fw("overwritten")();
+        fw.setpos(p);
+        fw("four")();
+        outs("pos")(p)(fw.getpos())();
+    }
+    {
+        // through a plain Writer&, the fd is still what gets written and closed
+        FdWriter fw("test-fd.txt",O_WRONLY|O_APPEND);
+        Writer& w = fw;
+        w.writebehind().buffering(8);
+        w("five")();
+        w.write("raw\n",4);
+        outs("no stream")(w.stream() == nullptr)();
+        w.close();
+        w("lost")();
+    }
+    {
+        // a copy leaves the fd open, and its text goes in with the original's
+        FdWriter fw("test-fd.txt",O_WRONLY|O_APPEND);
+        fw.sep(' ');
+        vector<int> v {1,2,3};
+        fw("before");
+        for_each(v.begin(),v.end(),fw);
+        fw("after")();
+    }
+    char line[80];
+    FILE *in = fopen("test-fd.txt","r");
+    while (fgets(line,sizeof(line),in)) {
+        line[strcspn(line,"\n")] = 0;
+        outs(line)();
+    }
+    fclose(in);
+    remove("test-fd.txt");
+}
+
 void building_strings() {
     outs("*building strings")();
     StrWriter sw(' ');
     sw(42)("and")(3.4);
 
     outs(sw.str())();
+
+    // formatted fields have no size limit
+    string dashes(200,'-');
+    sw.clear();
+    sw(dashes.c_str(),"[%s]")(1.0/3,"%.60f");
+    outs(sw.str().size())();
+
+    // a Writeable can reuse a StrWriter
+    Point P(1,2);
+    for (int i = 0; i < 2; i++) {
+        outs(P.to_string(sw))();
+    }
+    // each time starts a fresh line, with no separator before the first field
+    Fields F;
+    StrWriter swc(',');
+    for (int i = 0; i < 2; i++) {
+        outs("[" + F.to_string(swc) + "]")();
+    }
 }
 
 void macro_magic() {
@@ -79,6 +219,91 @@ void macro_magic() {
     #undef VX64
 }
 
+void compiled_formats() {
+    outs("*compiled formats")();
+    int i = -42;
+    uint64_t u = 0xFFFFFFFFFFULL;
+    double x = 2.5e-7;
+    string s = "hello";
+    // same output as the runtime form, which is shown first
+    outs.fmt("[%d|%5d|%-4u|%x|%#o] ",i,i,(unsigned)i,255,8);
+    outs.fmt<"[%d|%5d|%-4u|%x|%#o]\n">(i,i,(unsigned)i,255,8);
+    outs.fmt("[%g|%.3f|%e|%hhX|%c] ",x,x,x,i,'z');
+    outs.fmt<"[%g|%.3f|%e|%hhX|%c]\n">(x,x,x,i,'z');
+    outs.fmt("[%s|%8s|%.2s|%" PRIX64 "|100%%] ","hello","hello","hello",u);
+    outs.fmt<"[%s|%8s|%.2s|%X|100%%]\n">(s,"hello",s,u);
+}
+
+void writing_json() {
+    outs("*JSON")();
+    outs.sep(0);
+    StrWriter sw;
+    JsonWriter js(sw);
+    js.object()
+        ("name","Alice")("age",42)("ratio",0.1)("ok",true)("none",nullptr)
+        .array("tags")("a")("b").end()
+        .object("empty").end()
+    .end();
+    // strings are escaped, a long clean run and all
+    js.array()("say \"hi\"\n\tback\\slash")(string(40,'x') + "\x01")
+        (1.0/0.0)(-0.0)(1e300)(2.5f)(INT64_MIN)(UINT64_MAX)
+    .end();
+    // Writeables are strings; JsonWriteables bring their own structure; ranges are arrays
+    vector<int> vi = {10,20,30};
+    js.object()("point",Point(1,2))("segment",Segment(Point(0,0),Point(3,4)))
+        ("list",vi).key("raw").raw("1e3").end();
+    js.raw("[1,2]");
+    outs(sw.text());
+
+    sw.clear();
+    JsonWriter pretty(sw,json_pretty);
+    pretty.object()("id",1).array("xs")(1)(2).end().array("none").end()
+        .object("inner")("deep",range(vi)).end_all();
+    outs(sw.text());
+
+    // misuse is reported, not thrown
+    sw.clear();
+    JsonWriter bad(sw);
+    bad.object()(1);
+    outs("value without key: ")(bad.error())('\n');
+    JsonWriter bad2(sw);
+    bad2.end();
+    outs("end with nothing open: ")(bad2.error())('\n');
+    JsonWriter bad3(sw);
+    bad3.array().key("k");
+    outs("key in array: ")(bad3.error())(", depth ")(bad3.depth())('\n');
+    outs.sep(' ');
+}
+
+// the same fields through Writer and BasicWriter give the same text
+template <class W>
+void some_fields(W& w) {
+    vector<int> vi = {1,2,255};
+    w.sep(' ');
+    w("hello",quote_d)(42)(-7,"%5d")(255u,hex_u)('c')(2.5)(1e-7,"%.2e")();
+    w(Point(1,2))(range(vi),hex_bytes_l,':')(string("s"),quote_s)(uint64_t(1) << 40)();
+    w.fmt("%s=%d\n","x",10);
+}
+
+void basic_writers() {
+    outs("*basic writers")();
+    StrWriter sw;
+    some_fields(sw);
+    BasicWriter<StrSink> bs;
+    some_fields(bs);
+    outs(bs.sink().text() == sw.text() ? "string same" : "string differs")();
+    outs.fmt("%s",bs.sink().text().c_str());
+    // truncated, but still counting
+    char buf[24];
+    BasicWriter<BufSink> bb(buf,sizeof(buf));
+    some_fields(bb);
+    bb.flush();
+    outs(buf,quote_d)(bb.sink().truncated() ? "truncated" : "complete")
+        (bb.sink().needed() == sw.text().size() ? "needed all" : "needed less")();
+    BasicWriter<WriterSink> bw(outs);
+    some_fields(bw);
+}
+
 void outstream_tests() {
     outs("*basic tests")();
     // not initially true
@@ -96,12 +321,22 @@ void outstream_tests() {
 
     writing_to_file();
 
+    writing_to_fd();
+
     building_strings();
 
+    fixed_buffers();
+
     custom_type_point();
 
     macro_magic();
 
+    compiled_formats();
+
+    writing_json();
+
+    basic_writers();
+
  }
 
 
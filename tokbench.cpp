@@ -0,0 +1,107 @@
+// the delimiter scanner on its own: each tokenizer the CPU supports,
+// splitting rows with lots of whitespace and comma-separated rows
+#include "instream.h"
+#include "outstream.h"
+#include "tokenize.h"
+#include <vector>
+#include <time.h>
+using namespace std;
+using namespace stream;
+
+static uint64_t microsecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return 1000000L*ts.tv_sec + ts.tv_nsec/1000L;
+}
+
+const int rows = 500000;
+const int repeats = 5;
+
+// numbers padded out to fixed-width columns
+string wide_rows() {
+    StrWriter sw;
+    for (int i = 0; i < rows; i++) {
+        sw.fmt("%12d %20.6f %16s\t%10d\n",i,i*0.37,"name",i*3);
+    }
+    return sw.str();
+}
+
+string csv_rows() {
+    StrWriter sw;
+    for (int i = 0; i < rows; i++) {
+        sw.fmt("%d,%.6f,name,%d,%d\n",i,i*0.37,i*3,i%7);
+    }
+    return sw.str();
+}
+
+// the fields found by a byte-at-a-time loop, for comparison
+size_t split_bytes(const string& s, const Delims& d, vector<FieldPos>& fields) {
+    size_t n = 0;
+    const char *start = s.data(), *P = start, *end = P + s.size();
+    while (P < end) {
+        while (P < end && d[(unsigned char)*P]) ++P;
+        if (P == end) break;
+        const char *field = P;
+        while (P < end && ! d[(unsigned char)*P]) ++P;
+        FieldPos f = {(size_t)(field - start), (size_t)(P - field)};
+        fields.push_back(f);
+        ++n;
+    }
+    return n;
+}
+
+void report(const char *what, const char *name, const string& s, uint64_t us, size_t fields) {
+    double mb = (double)s.size()*repeats/(1024*1024);
+    outs(what)(name)(mb/(us/1e6),"%8.0f")("MB/s")(fields)("fields")();
+}
+
+void bench_split(const char *what, const string& s, const Delims& d) {
+    size_t n = 0;
+    vector<FieldPos> fields;
+    fields.reserve(8*rows);
+    uint64_t start = microsecs();
+    for (int r = 0; r < repeats; r++) {
+        fields.clear();
+        n = split_bytes(s,d,fields);
+    }
+    report(what,"bytes ",s,microsecs() - start,n);
+    for (int t = tokenizer_scalar; t <= tokenizer_avx2; t++) {
+        if (! set_tokenizer((Tokenizer)t)) continue;
+        uint64_t start = microsecs();
+        for (int r = 0; r < repeats; r++) {
+            fields.clear();
+            n = split_fields(s.data(),s.data()+s.size(),d,fields);
+        }
+        report(what,tokenizer_name((Tokenizer)t),s,microsecs() - start,n);
+    }
+}
+
+// reading the same rows as words through StrReader
+void bench_reader(const char *what, const string& s, const char *seps) {
+    for (int t = tokenizer_scalar; t <= tokenizer_avx2; t++) {
+        if (! set_tokenizer((Tokenizer)t)) continue;
+        size_t n = 0;
+        uint64_t start = microsecs();
+        for (int r = 0; r < repeats; r++) {
+            StrReader rdr(s);
+            rdr.separators(seps);
+            string word;
+            n = 0;
+            while (rdr(word)) ++n;
+        }
+        report(what,tokenizer_name((Tokenizer)t),s,microsecs() - start,n);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Tokenizer best = tokenizer();
+    outs("best tokenizer is")(tokenizer_name(best))();
+    string wide = wide_rows(), csv = csv_rows();
+    bench_split("split wide",wide,Delims());
+    bench_split("split csv ",csv,Delims(","));
+    bench_reader("words wide",wide,"");
+    bench_reader("words csv ",csv,",");
+    set_tokenizer(best);
+    return 0;
+}
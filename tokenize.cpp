@@ -0,0 +1,228 @@
+// Lightweight operator() overloading stdio wrapper
+// finding field boundaries many bytes at a time
+// Steve Donovan, (c) 2016
+// MIT license
+#include "tokenize.h"
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+
+namespace stream {
+
+Delims::Delims(const char *extra, bool space) : nx(0), ws(space) {
+    memset(bits,0,sizeof(bits));
+    memset(xs,0,sizeof(xs));
+    const char *white = space ? " \t\n\v\f\r" : "";
+    for (const char *P = white; *P; ++P) {
+        unsigned char c = *P;
+        bits[c >> 6] |= (uint64_t)1 << (c & 63);
+    }
+    for (const char *P = extra; *P && nx < (int)sizeof(xs); ++P) {
+        unsigned char c = *P;
+        bits[c >> 6] |= (uint64_t)1 << (c & 63);
+        xs[nx++] = *P;
+    }
+}
+
+// each implementation gives a mask of the delimiters among 64 bytes,
+// with bit i set if P[i] is one
+
+static uint64_t mask64_scalar(const char *P, const Delims& d) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64; ++i) {
+        m |= (uint64_t)d[(unsigned char)P[i]] << i;
+    }
+    return m;
+}
+
+#ifdef HAVE_X86_SIMD
+
+// whitespace is ' ' or in the range '\t'..'\r'; c - '\t' <= 4 (unsigned) is
+// tested as min(c - '\t', 4) == c - '\t'
+static inline __m128i delims_sse2(__m128i v, const Delims& d) {
+    __m128i m = _mm_setzero_si128();
+    if (d.space()) {
+        __m128i t = _mm_sub_epi8(v,_mm_set1_epi8('\t'));
+        m = _mm_or_si128(
+            _mm_cmpeq_epi8(v,_mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8(_mm_min_epu8(t,_mm_set1_epi8(4)),t)
+        );
+    }
+    for (int i = 0; i < d.extra_count(); ++i) {
+        m = _mm_or_si128(m,_mm_cmpeq_epi8(v,_mm_set1_epi8(d.extra()[i])));
+    }
+    return m;
+}
+
+static uint64_t mask64_sse2(const char *P, const Delims& d) {
+    uint64_t m = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(P + 16*i));
+        m |= (uint64_t)(uint16_t)_mm_movemask_epi8(delims_sse2(v,d)) << (16*i);
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i delims_avx2(__m256i v, const Delims& d) {
+    __m256i m = _mm256_setzero_si256();
+    if (d.space()) {
+        __m256i t = _mm256_sub_epi8(v,_mm256_set1_epi8('\t'));
+        m = _mm256_or_si256(
+            _mm256_cmpeq_epi8(v,_mm256_set1_epi8(' ')),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(t,_mm256_set1_epi8(4)),t)
+        );
+    }
+    for (int i = 0; i < d.extra_count(); ++i) {
+        m = _mm256_or_si256(m,_mm256_cmpeq_epi8(v,_mm256_set1_epi8(d.extra()[i])));
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+static uint64_t mask64_avx2(const char *P, const Delims& d) {
+    __m256i lo = _mm256_loadu_si256((const __m256i*)P);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(P + 32));
+    uint32_t mlo = (uint32_t)_mm256_movemask_epi8(delims_avx2(lo,d));
+    uint32_t mhi = (uint32_t)_mm256_movemask_epi8(delims_avx2(hi,d));
+    return ((uint64_t)mhi << 32) | mlo;
+}
+
+#endif
+
+typedef uint64_t (*Mask64)(const char *P, const Delims& d);
+
+static bool cpu_supports(Tokenizer t) {
+#ifdef HAVE_X86_SIMD
+    if (t == tokenizer_sse2) return __builtin_cpu_supports("sse2");
+    if (t == tokenizer_avx2) return __builtin_cpu_supports("avx2");
+#endif
+    return t == tokenizer_scalar;
+}
+
+static Tokenizer best_tokenizer() {
+    if (cpu_supports(tokenizer_avx2)) return tokenizer_avx2;
+    if (cpu_supports(tokenizer_sse2)) return tokenizer_sse2;
+    return tokenizer_scalar;
+}
+
+// resolved on first use, so that tokenizing from another static
+// initializer doesn't find them unset
+static Tokenizer& current() {
+    static Tokenizer t = best_tokenizer();
+    return t;
+}
+
+static Mask64 mask_fun(Tokenizer t) {
+#ifdef HAVE_X86_SIMD
+    if (t == tokenizer_avx2) return mask64_avx2;
+    if (t == tokenizer_sse2) return mask64_sse2;
+#endif
+    return mask64_scalar;
+}
+
+static Mask64& mask64() {
+    static Mask64 m = mask_fun(current());
+    return m;
+}
+
+Tokenizer tokenizer() {
+    return current();
+}
+
+bool set_tokenizer(Tokenizer t) {
+    if (! cpu_supports(t)) return false;
+    current() = t;
+    mask64() = mask_fun(t);
+    return true;
+}
+
+const char *tokenizer_name(Tokenizer t) {
+    switch(t) {
+    case tokenizer_avx2: return "avx2";
+    case tokenizer_sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+// a block is only classified when 64 bytes remain; the tail goes byte by byte
+
+const char *find_delim(const char *P, const char *end, const Delims& d) {
+    Mask64 mask = mask64();
+    while (end - P >= 64) {
+        uint64_t m = mask(P,d);
+        if (m != 0) return P + __builtin_ctzll(m);
+        P += 64;
+    }
+    while (P < end && ! d[(unsigned char)*P]) {
+        ++P;
+    }
+    return P;
+}
+
+const char *skip_delims(const char *P, const char *end, const Delims& d) {
+    Mask64 mask = mask64();
+    while (end - P >= 64) {
+        uint64_t m = ~mask(P,d);
+        if (m != 0) return P + __builtin_ctzll(m);
+        P += 64;
+    }
+    while (P < end && d[(unsigned char)*P]) {
+        ++P;
+    }
+    return P;
+}
+
+// Fields start where a delimiter is followed by anything else, and end
+// where the reverse happens; both are found for a whole block with shifts,
+// carrying the state of the last byte into the next block.
+size_t split_fields(const char *P, const char *end, const Delims& d, std::vector<FieldPos>& fields) {
+    Mask64 mask = mask64();
+    const char *start = P;
+    size_t count = 0;
+    bool in_field = false;
+    size_t field_start = 0;
+    while (P < end) {
+        uint64_t m;
+        size_t n = end - P;
+        if (n >= 64) {
+            m = mask(P,d);
+            n = 64;
+        } else {
+            m = 0;
+            for (size_t i = 0; i < n; ++i) {
+                m |= (uint64_t)d[(unsigned char)P[i]] << i;
+            }
+            m |= ~(uint64_t)0 << n; // past the end counts as a delimiter
+        }
+        uint64_t prev = (m << 1) | (in_field ? 0 : 1);
+        uint64_t starts = ~m & prev;
+        uint64_t ends = m & ~prev;
+        size_t base = P - start;
+        for (;;) {
+            if (! in_field) {
+                if (starts == 0) break;
+                field_start = base + __builtin_ctzll(starts);
+                starts &= starts - 1;
+                in_field = true;
+            }
+            if (ends == 0) break;
+            FieldPos f = {field_start, base + __builtin_ctzll(ends) - field_start};
+            fields.push_back(f);
+            ++count;
+            ends &= ends - 1;
+            in_field = false;
+        }
+        P += n;
+    }
+    if (in_field) {
+        FieldPos f = {field_start, (size_t)(end - start) - field_start};
+        fields.push_back(f);
+        ++count;
+    }
+    return count;
+}
+
+}
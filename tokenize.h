@@ -0,0 +1,61 @@
+// Lightweight operator() overloading stdio wrapper
+// finding field boundaries many bytes at a time
+// Steve Donovan, (c) 2016
+// MIT license
+
+#ifndef __OUTSTREAM_TOKENIZE_H
+#define __OUTSTREAM_TOKENIZE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace stream {
+
+/// the bytes which separate fields: whitespace (as isspace has it) unless `space`
+/// is false, and up to four extra separators such as ',' or '|'
+class Delims {
+    uint64_t bits[4];
+    char xs[4];
+    int nx;
+    bool ws;
+public:
+    Delims(const char *extra = "", bool space = true);
+
+    bool operator[] (unsigned char c) const {
+        return (bits[c >> 6] >> (c & 63)) & 1;
+    }
+    const char *extra() const { return xs; }
+    int extra_count() const { return nx; }
+    bool space() const { return ws; }
+};
+
+enum Tokenizer {
+    tokenizer_scalar,
+    tokenizer_sse2,
+    tokenizer_avx2
+};
+
+/// the implementation in use; the best the CPU supports, unless set_tokenizer was called
+Tokenizer tokenizer();
+/// force an implementation, which is useful for testing; false if the CPU can't do it
+bool set_tokenizer(Tokenizer t);
+const char *tokenizer_name(Tokenizer t);
+
+/// the first delimiter in [P,end), or end
+const char *find_delim(const char *P, const char *end, const Delims& d);
+/// the first byte in [P,end) that isn't a delimiter, or end
+const char *skip_delims(const char *P, const char *end, const Delims& d);
+
+/// a field as an offset and length
+struct FieldPos {
+    size_t start;
+    size_t len;
+};
+
+/// append every field in [P,end) to `fields`, with offsets from P, and return how many;
+/// this works a block of 64 bytes at a time, so that a row is split in one pass
+size_t split_fields(const char *P, const char *end, const Delims& d, std::vector<FieldPos>& fields);
+
+}
+
+#endif